@@ -0,0 +1,180 @@
+#pragma once
+
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// skipping runs of characters of one class, 32 (avx2) or 16 (sse2) bytes per step;
+// a chunk is loaded at any position up to the terminating '\0', so sources are followed
+// by padding zero bytes, the terminator included
+
+
+namespace mandalang::character_runs {
+
+
+#if defined(__AVX2__)
+
+    using chunk = __m256i;
+    constexpr std::size_t chunk_size = 32;
+    constexpr std::uint32_t chunk_bits = 0xffffffffu;
+
+    inline chunk load(char const* p) noexcept { return _mm256_loadu_si256(reinterpret_cast<chunk const*>(p)); }
+    inline chunk broadcast(char c) noexcept { return _mm256_set1_epi8(c); }
+    inline chunk equals(chunk a, chunk b) noexcept { return _mm256_cmpeq_epi8(a, b); }
+    inline chunk greater(chunk a, chunk b) noexcept { return _mm256_cmpgt_epi8(a, b); }
+    inline chunk either(chunk a, chunk b) noexcept { return _mm256_or_si256(a, b); }
+    inline chunk both(chunk a, chunk b) noexcept { return _mm256_and_si256(a, b); }
+    inline std::uint32_t bits(chunk a) noexcept { return std::uint32_t(_mm256_movemask_epi8(a)); }
+
+#define MANDALANG_CHARACTER_RUNS_VECTORIZED
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+    using chunk = __m128i;
+    constexpr std::size_t chunk_size = 16;
+    constexpr std::uint32_t chunk_bits = 0xffffu;
+
+    inline chunk load(char const* p) noexcept { return _mm_loadu_si128(reinterpret_cast<chunk const*>(p)); }
+    inline chunk broadcast(char c) noexcept { return _mm_set1_epi8(c); }
+    inline chunk equals(chunk a, chunk b) noexcept { return _mm_cmpeq_epi8(a, b); }
+    inline chunk greater(chunk a, chunk b) noexcept { return _mm_cmpgt_epi8(a, b); }
+    inline chunk either(chunk a, chunk b) noexcept { return _mm_or_si128(a, b); }
+    inline chunk both(chunk a, chunk b) noexcept { return _mm_and_si128(a, b); }
+    inline std::uint32_t bits(chunk a) noexcept { return std::uint32_t(_mm_movemask_epi8(a)); }
+
+#define MANDALANG_CHARACTER_RUNS_VECTORIZED
+
+#endif
+
+
+#if defined(MANDALANG_CHARACTER_RUNS_VECTORIZED)
+    constexpr std::size_t padding = chunk_size;
+#else
+    constexpr std::size_t padding = 1;
+#endif
+
+
+    inline bool is_space(char c) noexcept {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+
+    inline bool is_digit(char c) noexcept {
+        return c >= '0' && c <= '9';
+    }
+
+
+    inline bool is_letter_or_digit(char c) noexcept {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c) || c == '_';
+    }
+
+
+#if defined(MANDALANG_CHARACTER_RUNS_VECTORIZED)
+
+    // chars above 0x7f are negative for signed comparison, so they never fall into a range
+    inline chunk in_range(chunk c, char from, char to) noexcept {
+        return both(greater(c, broadcast(char(from - 1))), greater(broadcast(char(to + 1)), c));
+    }
+
+
+    inline chunk spaces(chunk c) noexcept {
+        return either(either(equals(c, broadcast(' ')), equals(c, broadcast('\t'))),
+                      either(equals(c, broadcast('\r')), equals(c, broadcast('\n'))));
+    }
+
+
+    inline chunk digits(chunk c) noexcept {
+        return in_range(c, '0', '9');
+    }
+
+
+    inline chunk letters_or_digits(chunk c) noexcept {
+        return either(either(in_range(c, 'a', 'z'), in_range(c, 'A', 'Z')),
+                      either(digits(c), equals(c, broadcast('_'))));
+    }
+
+
+    inline chunk line_ends(chunk c) noexcept {
+        return either(equals(c, broadcast('\n')), equals(c, broadcast('\0')));
+    }
+
+
+    // first character at or after p with a bit set in stops mask, '\0' is always a stop
+    template<typename Stops> char const* find(char const* p, Stops stops) noexcept {
+        for(;; p += chunk_size) {
+            auto const mask = stops(load(p));
+            if(mask != 0)
+                return p + std::countr_zero(mask);
+        }
+    }
+
+
+    inline char const* skip_spaces(char const* p, unsigned& line_no) noexcept {
+        for(;; p += chunk_size) {
+            auto const c = load(p);
+            auto const mask = ~bits(spaces(c)) & chunk_bits;
+            auto const new_lines = bits(equals(c, broadcast('\n')));
+            if(mask != 0) {
+                auto const run = std::countr_zero(mask);
+                line_no += unsigned(std::popcount(new_lines & ((1u << run) - 1u)));
+                return p + run;
+            }
+            line_no += unsigned(std::popcount(new_lines));
+        }
+    }
+
+
+    inline char const* skip_digits(char const* p) noexcept {
+        return find(p, [](chunk c) noexcept { return ~bits(digits(c)) & chunk_bits; });
+    }
+
+
+    inline char const* skip_letters_or_digits(char const* p) noexcept {
+        return find(p, [](chunk c) noexcept { return ~bits(letters_or_digits(c)) & chunk_bits; });
+    }
+
+
+    // position of '\n' or terminating '\0' at or after p
+    inline char const* skip_line(char const* p) noexcept {
+        return find(p, [](chunk c) noexcept { return bits(line_ends(c)); });
+    }
+
+#else
+
+    inline char const* skip_spaces(char const* p, unsigned& line_no) noexcept {
+        for(; is_space(*p); ++p)
+            if(*p == '\n')
+                ++line_no;
+        return p;
+    }
+
+
+    inline char const* skip_digits(char const* p) noexcept {
+        while(is_digit(*p))
+            ++p;
+        return p;
+    }
+
+
+    inline char const* skip_letters_or_digits(char const* p) noexcept {
+        while(is_letter_or_digit(*p))
+            ++p;
+        return p;
+    }
+
+
+    inline char const* skip_line(char const* p) noexcept {
+        while(*p != '\n' && *p != '\0')
+            ++p;
+        return p;
+    }
+
+#endif
+
+
+} // namespace mandalang::character_runs
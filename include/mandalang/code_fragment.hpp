@@ -1,11 +1,15 @@
 #pragma once
 
 
+#include <memory>
+#include <string>
+
 #include <nonstd/memory_pool.hpp>
 
+#include <mandalang/character_runs.hpp>
 #include <mandalang/ir.hpp>
 #include <mandalang/scope.hpp>
-#include <mandalang/type.hpp>
+#include <mandalang/source_mapping.hpp>
 
 
 namespace mandalang {
@@ -13,10 +17,26 @@ namespace mandalang {
 
     struct code_fragment {
         std::string source;
-        nonstd::memory_pool<composite_type> composite_types;
+        std::unique_ptr<source_mapping> mapping;
         nonstd::memory_pool<ast_node> ast;
         nonstd::memory_pool<symbol> symbols;
         nonstd::memory_pool<scope> scopes;
+
+        // fragments of loaded modules are scanned in place from the mapped file, others from
+        // a copy of the source followed by the zero padding scanner reads whole chunks into
+        char const* text() {
+            if(mapping)
+                return mapping->data();
+            if(padded_.empty()) {
+                padded_.reserve(source.size() + character_runs::padding);
+                padded_.append(source).append(character_runs::padding, '\0');
+            }
+            return padded_.data();
+        }
+
+    private:
+
+        std::string padded_;
     }; // code_fragment
 
 
@@ -0,0 +1,192 @@
+#pragma once
+
+
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MANDALANG_MAPPED_COLUMNS
+#endif
+
+#include <tl/expected.hpp>
+
+#include <configure.hpp>
+#include <mandalang/error_info.hpp>
+
+
+namespace mandalang {
+
+
+    // read-only mapping of a file holding one column of packed little-endian doubles or
+    // 64-bit integers after a fixed header; pages are read as items are first touched and
+    // may be dropped again under memory pressure, so a column may be larger than memory
+    class column_file {
+    public:
+
+        enum class item_kind : std::uint32_t {
+            floating_point = 1,
+            integer = 2
+        }; // item_kind
+
+    private:
+
+        static constexpr std::uint32_t format_version = 1;
+        static constexpr char magic[8] = {'M', 'L', 'C', 'O', 'L', 'U', 'M', 'N'};
+        // items start at the next multiple of alignment, as items of vectors an image holds
+        static constexpr std::uint64_t items_offset = 32;
+
+        struct header {
+            char magic[8];
+            std::uint32_t version;
+            item_kind kind;
+            std::uint64_t count;
+            std::uint64_t offset;
+        };
+        static_assert(sizeof(header) <= items_offset);
+
+        void const* data_{nullptr};
+        std::size_t size_{0};
+        item_kind kind_{item_kind::floating_point};
+        std::size_t count_{0};
+        std::size_t offset_{0};
+
+        column_file() noexcept = default;
+
+    public:
+
+        column_file(column_file const&) = delete;
+        column_file& operator = (column_file const&) = delete;
+
+        item_kind kind() const noexcept { return kind_; }
+        std::size_t count() const noexcept { return count_; }
+        void const* items() const noexcept { return static_cast<char const*>(data_) + offset_; }
+
+
+        static tl::expected<void, error_info> save(std::string const& path, std::span<double const> items) {
+            return write_file(path, item_kind::floating_point, items.data(), items.size());
+        }
+
+
+        static tl::expected<void, error_info> save(std::string const& path, std::span<std::int64_t const> items) {
+            return write_file(path, item_kind::integer, items.data(), items.size());
+        }
+
+
+#if defined(MANDALANG_MAPPED_COLUMNS)
+
+        ~column_file() {
+            if(data_ != nullptr)
+                ::munmap(const_cast<void*>(data_), size_);
+        }
+
+
+        static tl::expected<std::shared_ptr<column_file>, error_info> open(std::string const& path) {
+            auto const file = ::open(path.c_str(), O_RDONLY);
+            if(file == -1)
+                return failed(std::error_code{errno, std::generic_category()});
+            auto mapped = map(file, path);
+            ::close(file);
+            return mapped;
+        }
+
+    private:
+
+        static tl::expected<std::shared_ptr<column_file>, error_info> map(int file, std::string const& path) {
+            struct stat status;
+            if(::fstat(file, &status) == -1)
+                return failed(std::error_code{errno, std::generic_category()});
+            auto const size = std::size_t(status.st_size);
+            auto h = header{};
+            if(size < sizeof(header) || ::pread(file, &h, sizeof(header), 0) != ssize_t(sizeof(header)))
+                return failed(error::invalid_column_file, path);
+            auto const checked = check(h, size, path);
+            if(!checked)
+                return tl::make_unexpected(checked.error());
+            auto* memory = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+            if(memory == MAP_FAILED)
+                return failed(std::error_code{errno, std::generic_category()});
+            auto column = std::shared_ptr<column_file>{new column_file{}};
+            column->data_ = memory;
+            column->size_ = size;
+            column->kind_ = h.kind;
+            column->count_ = std::size_t(h.count);
+            column->offset_ = std::size_t(h.offset);
+            // formulas read columns front to back, so pages ahead are read early and pages behind dropped early
+            ::madvise(memory, size, MADV_SEQUENTIAL);
+            return {std::move(column)};
+        }
+
+#else
+
+        static tl::expected<std::shared_ptr<column_file>, error_info> open(std::string const&) {
+            return failed(std::make_error_code(std::errc::not_supported));
+        }
+
+    private:
+
+#endif
+
+        static std::size_t item_size(item_kind kind) noexcept {
+            return kind == item_kind::floating_point ? sizeof(double) : sizeof(std::int64_t);
+        }
+
+
+        static tl::expected<void, error_info> check(header const& h, std::size_t size, std::string const& path) {
+            if(std::endian::native != std::endian::little)
+                return failed(std::make_error_code(std::errc::not_supported));
+            if(std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != format_version
+               || (h.kind != item_kind::floating_point && h.kind != item_kind::integer)
+               || h.offset < sizeof(header) || h.offset % item_size(h.kind) != 0 || h.offset > size
+               || h.count > (size - h.offset) / item_size(h.kind))
+                return failed(error::invalid_column_file, path);
+            if(h.kind == item_kind::integer && sizeof(platform::integer) != sizeof(std::int64_t))
+                return failed(error::invalid_column_file, path);
+            return {};
+        }
+
+
+        // file is written to a temporary one first, so readers never see a partial file
+        static tl::expected<void, error_info> write_file(std::string const& path, item_kind kind, void const* items,
+                                                         std::size_t count) {
+            if(std::endian::native != std::endian::little)
+                return failed(std::make_error_code(std::errc::not_supported));
+            auto h = header{};
+            std::memcpy(h.magic, magic, sizeof(magic));
+            h.version = format_version;
+            h.kind = kind;
+            h.count = count;
+            h.offset = items_offset;
+            char head[items_offset] = {};
+            std::memcpy(head, &h, sizeof(header));
+            auto const temporary_path = path + ".tmp";
+            {
+                auto file = std::ofstream{temporary_path, std::ios::binary | std::ios::trunc};
+                if(!file.write(head, sizeof(head))
+                   || !file.write(static_cast<char const*>(items), std::streamsize(count * item_size(kind)))
+                   || !file.flush())
+                    return failed(std::make_error_code(std::errc::io_error));
+            }
+            if(std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+                std::remove(temporary_path.c_str());
+                return failed(std::error_code{errno, std::generic_category()});
+            }
+            return {};
+        }
+
+    }; // column_file
+
+
+} // namespace mandalang
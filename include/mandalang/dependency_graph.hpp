@@ -0,0 +1,144 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+#include <mandalang/error_info.hpp>
+#include <mandalang/evaluator.hpp>
+#include <mandalang/ir.hpp>
+
+
+namespace mandalang {
+
+
+    // value definitions of a module with globals their expressions read; a changed global
+    // has its transitive dependents evaluated again from their resolved expressions, in
+    // order of definition, as a definition only reads globals defined before it
+    class dependency_graph {
+
+        struct definition {
+            ast_node* expression;
+            std::vector<symbol const*> reads;
+            std::uint64_t sequence;
+        };
+
+        mutable std::mutex mutex_;
+        std::unordered_map<symbol const*, definition> definitions_;
+        std::unordered_map<symbol const*, std::vector<symbol*>> dependents_;
+        std::uint64_t sequence_{0};
+
+    public:
+
+        dependency_graph() noexcept = default;
+        dependency_graph(dependency_graph const&) = delete;
+        dependency_graph& operator = (dependency_graph const&) = delete;
+
+
+        // a definition replaces the previous one of the symbol, definitions reading it are
+        // not evaluated again, as definitions are evaluated in order; a definition reading
+        // its own previous value can not be evaluated again and is not recorded
+        void define(symbol* defined, ast_node* expression, std::vector<symbol const*> reads) {
+            auto const lock = std::lock_guard{mutex_};
+            erase(defined);
+            std::sort(reads.begin(), reads.end());
+            reads.erase(std::unique(reads.begin(), reads.end()), reads.end());
+            if(std::binary_search(reads.begin(), reads.end(), defined))
+                return;
+            for(auto const* each_read: reads)
+                dependents_[each_read].push_back(defined);
+            definitions_.try_emplace(defined, definition{expression, std::move(reads), sequence_++});
+        }
+
+
+        // the symbol is set from outside and is not evaluated again, definitions reading it stay
+        void forget(symbol const* defined) {
+            auto const lock = std::lock_guard{mutex_};
+            erase(defined);
+        }
+
+
+        // visits(defined, expression, reads) every recorded definition in order of definition,
+        // so defining them again in that order restores the graph
+        template<typename F> void for_each(F visit) const {
+            auto const lock = std::lock_guard{mutex_};
+            auto ordered = std::vector<std::pair<symbol const*, definition const*>>{};
+            ordered.reserve(definitions_.size());
+            for(auto const& [defined, each_definition]: definitions_)
+                ordered.emplace_back(defined, &each_definition);
+            std::sort(ordered.begin(), ordered.end(), [](auto const& a, auto const& b) {
+                return a.second->sequence < b.second->sequence;
+            });
+            for(auto const& [defined, each_definition]: ordered)
+                visit(defined, each_definition->expression, each_definition->reads);
+        }
+
+
+        bool has_dependents(symbol const* s) {
+            auto const lock = std::lock_guard{mutex_};
+            auto const found = dependents_.find(s);
+            return found != dependents_.end() && !found->second.empty();
+        }
+
+
+        // evaluates dependents of changed symbols again and appends them to changed,
+        // evaluation stops at the first failed one leaving the rest with previous values
+        tl::expected<void, error_info> recompute(std::vector<symbol const*>& changed) {
+            auto const lock = std::lock_guard{mutex_};
+            auto affected = std::vector<symbol*>{};
+            // changed symbols keep their values even if a definition cycles back to them
+            auto visited = std::unordered_set<symbol const*>{changed.begin(), changed.end()};
+            auto pending = std::vector<symbol const*>{changed};
+            while(!pending.empty()) {
+                auto const* each_symbol = pending.back();
+                pending.pop_back();
+                auto const found = dependents_.find(each_symbol);
+                if(found == dependents_.end())
+                    continue;
+                for(auto* each_dependent: found->second) {
+                    if(!visited.insert(each_dependent).second)
+                        continue;
+                    affected.push_back(each_dependent);
+                    pending.push_back(each_dependent);
+                }
+            }
+            std::sort(affected.begin(), affected.end(), [this](symbol const* a, symbol const* b) {
+                return definitions_.at(a).sequence < definitions_.at(b).sequence;
+            });
+            for(auto* each_symbol: affected) {
+                evaluator evaluator;
+                auto const expected_value = evaluator.evaluate(definitions_.at(each_symbol).expression);
+                if(!expected_value)
+                    return tl::make_unexpected(expected_value.error());
+                each_symbol->redefine(*expected_value);
+                changed.push_back(each_symbol);
+            }
+            return {};
+        }
+
+    private:
+
+        void erase(symbol const* defined) {
+            auto const found = definitions_.find(defined);
+            if(found == definitions_.end())
+                return;
+            for(auto const* each_read: found->second.reads) {
+                auto const readers = dependents_.find(each_read);
+                if(readers != dependents_.end())
+                    readers->second.erase(std::remove(readers->second.begin(), readers->second.end(), defined),
+                                          readers->second.end());
+            }
+            definitions_.erase(found);
+        }
+
+    }; // dependency_graph
+
+
+} // namespace mandalang
@@ -1,37 +1,54 @@
 #pragma once
 
 
+#include <cstring>
+#include <list>
 #include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 #include <tl/expected.hpp>
 
 #include <mandalang/ir.hpp>
+#include <mandalang/column_file.hpp>
 #include <mandalang/error_info.hpp>
+#include <mandalang/expression_cache.hpp>
+#include <mandalang/loader.hpp>
 #include <mandalang/mod.hpp>
+#include <mandalang/module_image.hpp>
+#include <mandalang/name_table.hpp>
+#include <mandalang/parallel_loader.hpp>
 #include <mandalang/modules/prelude.hpp>
+#include <mandalang/shared_segment.hpp>
+#include <mandalang/snapshot.hpp>
+#include <mandalang/thread_pool.hpp>
 #include <mandalang/type.hpp>
+#include <mandalang/type_table.hpp>
 
 
 namespace mandalang {
 
     class engine {
 
-        mod default_module_;
-        std::unique_ptr<modules::prelude> prelude_;
+        static constexpr auto default_expression_cache_capacity = std::size_t(256);
 
-        engine() noexcept = default;
+        name_table names_;
+        type_table types_;
+        mod default_module_{types_, names_, &modules::prelude::instance().exported()};
+        std::list<std::unique_ptr<mod>> modules_;
+        std::unique_ptr<thread_pool> workers_;
+        expression_cache expressions_{default_expression_cache_capacity};
+        bool module_images_{false};
+        bool lazy_definitions_{false};
+
+        engine() = default;
 
     public:
 
         static tl::expected<std::unique_ptr<engine>, error_info> create() noexcept {
             try {
                 auto engine = std::unique_ptr<class engine>{new class engine()};
-                auto expected_prelude = modules::prelude::initialize();
-                if(!expected_prelude)
-                    return tl::make_unexpected(expected_prelude.error());
-                engine->prelude_ = std::move(*expected_prelude);
-                engine->default_module_.import(engine->prelude_->exported());
                 return {std::move(engine)};
             } catch (std::bad_alloc const&) {
                 return failed(error::not_enough_memory);
@@ -39,15 +56,85 @@ namespace mandalang {
         }
 
 
+        front_end_mode front_end() const noexcept {
+            return default_module_.front_end();
+        }
+
+
+        void front_end(front_end_mode mode) noexcept {
+            default_module_.front_end(mode);
+        }
+
+
+        bool module_images() const noexcept {
+            return module_images_;
+        }
+
+
+        // loaded modules are restored from and saved to images next to their sources,
+        // off unless asked for, as images are files written beside the sources of the user
+        void module_images(bool enabled) noexcept {
+            module_images_ = enabled;
+        }
+
+
+        bool lazy_definitions() const noexcept {
+            return lazy_definitions_;
+        }
+
+
+        // definitions of loaded modules are compiled on the first reference to them, a lazy
+        // definition sees redefinitions made before that reference; up to date images are
+        // still preferred, but modules loaded lazily are not imaged
+        void lazy_definitions(bool enabled) noexcept {
+            lazy_definitions_ = enabled;
+        }
+
+
+        std::size_t expression_cache_capacity() const noexcept {
+            return expressions_.capacity();
+        }
+
+
+        // resubmitted expressions are evaluated from compiled ones, zero capacity disables caching
+        void expression_cache_capacity(std::size_t capacity) noexcept {
+            expressions_.capacity(capacity);
+        }
+
+
+        expression_cache::statistics const& expression_cache_statistics() const noexcept {
+            return expressions_.stats();
+        }
+
+
         tl::expected<value, error_info> evaluate_expression(std::string const& source) noexcept {
             try {
-                return default_module_.evaluate_expression(std::move(source));
+                if(expressions_.capacity() == 0)
+                    return default_module_.evaluate_expression(source);
+                auto const expression = cached_expression(source);
+                if(!expression)
+                    return tl::make_unexpected(expression.error());
+                return default_module_.evaluate_solved_expression(*expression);
             } catch (std::bad_alloc const&) {
                 return failed(error::not_enough_memory);
             }
         }
 
 
+        // evaluates a vector expression into memory of the host and returns the count of items;
+        // element-wise arithmetic, map and zip make their items right there, other results
+        // are copied; the memory may hold items of a bound vector the expression reads
+        tl::expected<std::size_t, error_info> evaluate_into(std::string const& source, std::span<double> items) noexcept {
+            return evaluate_items_into(source, type_tag::floating_point, items.data(), items.size(), sizeof(double));
+        }
+
+
+        tl::expected<std::size_t, error_info> evaluate_into(std::string const& source,
+                                                            std::span<platform::integer> items) noexcept {
+            return evaluate_items_into(source, type_tag::integer, items.data(), items.size(), sizeof(platform::integer));
+        }
+
+
         tl::expected<symbol_or_value, error_info> evaluate_definition_or_expression(std::string source) noexcept {
             try {
                 return default_module_.evaluate_definition_or_expression(std::move(source));
@@ -57,15 +144,323 @@ namespace mandalang {
         }
 
 
+        // loads definitions of a module file and imports its public names into default module
+        tl::expected<mod const*, error_info> load(std::string const& path) noexcept {
+            try {
+                auto expected_module = loader::load(path, types_, names_, prelude(), module_images_, lazy_definitions_);
+                if(!expected_module)
+                    return tl::make_unexpected(expected_module.error());
+                auto const imported = default_module_.import((*expected_module)->publics());
+                if(!imported)
+                    return tl::make_unexpected(imported.error());
+                modules_.push_back(std::move(*expected_module));
+                return {modules_.back().get()};
+            } catch (std::bad_alloc const&) {
+                return failed(error::not_enough_memory);
+            }
+        }
+
+
+        // loads module files concurrently, public names are imported in order of paths
+        tl::expected<std::vector<mod const*>, error_info> load(std::vector<std::string> const& paths) noexcept {
+            try {
+                if(!workers_)
+                    workers_ = std::make_unique<thread_pool>();
+                auto expected_modules = parallel_loader::load(paths, types_, names_, prelude(), *workers_,
+                                                              module_images_, lazy_definitions_);
+                if(!expected_modules)
+                    return tl::make_unexpected(expected_modules.error());
+                auto loaded = std::vector<mod const*>{};
+                loaded.reserve(expected_modules->size());
+                for(auto& each_module: *expected_modules) {
+                    auto const imported = default_module_.import(each_module->publics());
+                    if(!imported)
+                        return tl::make_unexpected(imported.error());
+                    loaded.push_back(each_module.get());
+                    modules_.push_back(std::move(each_module));
+                }
+                return {std::move(loaded)};
+            } catch (std::bad_alloc const&) {
+                return failed(error::not_enough_memory);
+            }
+        }
+
+
+        // publishes the image of a loaded module in a named shared memory segment
+        tl::expected<void, error_info> share(mod const& module, std::string const& segment) const noexcept {
+            try {
+                for(auto const& each_module: modules_) {
+                    if(each_module.get() != &module)
+                        continue;
+                    auto const compiled = each_module->compile_deferred();
+                    if(!compiled)
+                        return compiled;
+                }
+                auto defined = std::vector<symbol const*>{};
+                module.publics().for_each([&](symbol const& each_symbol) { defined.push_back(&each_symbol); });
+                auto const expected_image = module_image::write(module, defined, 0, 0);
+                if(!expected_image)
+                    return tl::make_unexpected(expected_image.error());
+                auto const published = shared_segment::publish(segment, *expected_image);
+                if(!published)
+                    return tl::make_unexpected(published.error());
+                return {};
+            } catch (std::bad_alloc const&) {
+                return failed(error::not_enough_memory);
+            }
+        }
+
+
+        // module from a segment published by another process and imported into default module;
+        // vectors of the module are read in place from the segment, evaluation state stays private
+        tl::expected<mod const*, error_info> attach(std::string const& segment) noexcept {
+            try {
+                auto const expected_segment = shared_segment::attach(segment);
+                if(!expected_segment)
+                    return tl::make_unexpected(expected_segment.error());
+                auto const& attached = *expected_segment;
+                auto expected_module = module_image::load(attached->data(), attached->size(), 0, 0,
+                                                          types_, names_, prelude(), attached);
+                if(!expected_module)
+                    return tl::make_unexpected(expected_module.error());
+                auto name = std::string_view{segment};
+                if(!name.empty() && name.front() == '/')
+                    name.remove_prefix(1);
+                (*expected_module)->name(names_.intern(name).text);
+                auto const imported = default_module_.import((*expected_module)->publics());
+                if(!imported)
+                    return tl::make_unexpected(imported.error());
+                modules_.push_back(std::move(*expected_module));
+                return {modules_.back().get()};
+            } catch (std::bad_alloc const&) {
+                return failed(error::not_enough_memory);
+            }
+        }
+
+
+        // restores an engine from a snapshot: modules are imported in the order they were loaded,
+        // then globals of the default module are restored over them
+        static tl::expected<std::unique_ptr<engine>, error_info> restore(std::string const& path) noexcept {
+            try {
+                auto expected_engine = create();
+                if(!expected_engine)
+                    return expected_engine;
+                auto& restored = **expected_engine;
+                auto const expected_snapshot = snapshot::open(path);
+                if(!expected_snapshot)
+                    return tl::make_unexpected(expected_snapshot.error());
+                auto const& entries = expected_snapshot->entries();
+                for(auto i = std::size_t(0); i + 1 != entries.size(); ++i) {
+                    auto m = std::make_unique<mod>(restored.types_, restored.names_, &prelude());
+                    m->name(restored.names_.intern(entries[i].name).text);
+                    auto const expected_defined = module_image::read(entries[i].image.data(), entries[i].image.size(),
+                                                                     0, 0, *m, expected_snapshot->keeper());
+                    if(!expected_defined)
+                        return tl::make_unexpected(expected_defined.error());
+                    for(auto* each_symbol: *expected_defined)
+                        m->publics_.define(each_symbol);
+                    auto const imported = restored.default_module_.import(m->publics());
+                    if(!imported)
+                        return tl::make_unexpected(imported.error());
+                    restored.modules_.push_back(std::move(m));
+                }
+                auto const& last = entries.back();
+                auto const expected_defined = module_image::read(last.image.data(), last.image.size(), 0, 0,
+                                                                 restored.default_module_, expected_snapshot->keeper());
+                if(!expected_defined)
+                    return tl::make_unexpected(expected_defined.error());
+                restored.front_end(expected_snapshot->front_end());
+                return expected_engine;
+            } catch (std::bad_alloc const&) {
+                return failed(error::not_enough_memory);
+            }
+        }
+
+
+        // saves loaded modules and own globals of the default module
+        tl::expected<void, error_info> save_snapshot(std::string const& path) const noexcept {
+            try {
+                auto images = std::vector<std::string>{};
+                auto entries = std::vector<snapshot::entry>{};
+                images.reserve(modules_.size() + 1);
+                for(auto const& each_module: modules_) {
+                    auto const compiled = each_module->compile_deferred();
+                    if(!compiled)
+                        return compiled;
+                    auto defined = std::vector<symbol const*>{};
+                    each_module->publics().for_each([&](symbol const& each_symbol) { defined.push_back(&each_symbol); });
+                    auto expected_image = module_image::write(*each_module, defined, 0, 0);
+                    if(!expected_image)
+                        return tl::make_unexpected(expected_image.error());
+                    images.push_back(std::move(*expected_image));
+                    entries.push_back(snapshot::entry{each_module->name(), images.back()});
+                }
+                auto defined = std::vector<symbol const*>{};
+                default_module_.globals().for_each([&](symbol const& each_symbol) {
+                    if(!is_imported(each_symbol))
+                        defined.push_back(&each_symbol);
+                });
+                auto expected_image = module_image::write(default_module_, defined, 0, 0);
+                if(!expected_image)
+                    return tl::make_unexpected(expected_image.error());
+                images.push_back(std::move(*expected_image));
+                entries.push_back(snapshot::entry{"", images.back()});
+                return snapshot::save(path, front_end(), entries);
+            } catch (std::bad_alloc const&) {
+                return failed(error::not_enough_memory);
+            }
+        }
+
+
+        // an imported name is redefined in its module, so definitions reading it are evaluated
+        // again in loaded modules first and then in default module, which may read theirs
         tl::expected<symbol const*, error_info> redefine(std::string_view name, value const& value) {
             try {
-                return {default_module_.redefine(name, value)};
+                auto const id = names_.intern(name);
+                auto const* existing = default_module_.globals_.find(id.id);
+                if(mod::changes_type(existing, value) && has_dependents(existing))
+                    return failed(error::redefinition_changes_type, name);
+                default_module_.track_version(id, value);
+                auto const* redefined = default_module_.globals_.redefine(id, value, default_module_.common_symbols_);
+                auto changed = std::vector<symbol const*>{redefined};
+                for(auto& each_module: modules_) {
+                    each_module->dependencies_.forget(redefined);
+                    auto const recomputed = each_module->dependencies_.recompute(changed);
+                    if(!recomputed)
+                        return tl::make_unexpected(recomputed.error());
+                }
+                default_module_.dependencies_.forget(redefined);
+                auto const recomputed = default_module_.dependencies_.recompute(changed);
+                if(!recomputed)
+                    return tl::make_unexpected(recomputed.error());
+                return {redefined};
+            } catch (std::bad_alloc const&) {
+                return failed(error::not_enough_memory);
+            }
+        }
+
+
+        // defines a global vector reading items of the host in place, which are never written
+        // but by evaluate_into; the host keeps them alive and unchanged while values refer to
+        // them, which is until the name is redefined when no other global is defined as it,
+        // unless owner is given to be kept instead
+        tl::expected<symbol const*, error_info> bind(std::string_view name, std::span<double const> items,
+                                                     std::shared_ptr<void const> owner = {}) {
+            return bind_items(name, type_tag::floating_point, items.data(), items.size(), std::move(owner));
+        }
+
+
+        tl::expected<symbol const*, error_info> bind(std::string_view name, std::span<platform::integer const> items,
+                                                     std::shared_ptr<void const> owner = {}) {
+            return bind_items(name, type_tag::integer, items.data(), items.size(), std::move(owner));
+        }
+
+
+        // defines a global vector reading items of a column file in place, the file stays
+        // mapped while values refer to it and should not be changed meanwhile
+        tl::expected<symbol const*, error_info> bind_column(std::string_view name, std::string const& path) {
+            try {
+                auto const expected_column = column_file::open(path);
+                if(!expected_column)
+                    return tl::make_unexpected(expected_column.error());
+                auto const& column = *expected_column;
+                auto const item_tag = column->kind() == column_file::item_kind::integer
+                        ? type_tag::integer
+                        : type_tag::floating_point;
+                return bind_items(name, item_tag, column->items(), column->count(), column);
             } catch (std::bad_alloc const&) {
                 return failed(error::not_enough_memory);
             }
         }
 
 
+    private:
+
+        static scope const& prelude() {
+            return modules::prelude::instance().exported();
+        }
+
+
+        tl::expected<ast_node*, error_info> cached_expression(std::string const& source) {
+            auto* expression = expressions_.find(source, default_module_.version());
+            if(expression != nullptr)
+                return expression;
+            auto fragment = std::make_unique<code_fragment>();
+            fragment->source = source;
+            auto const compiled = default_module_.compile_expression(*fragment);
+            if(!compiled)
+                return tl::make_unexpected(compiled.error());
+            return expressions_.insert(std::move(fragment), *compiled, default_module_.version());
+        }
+
+
+        // an owner aliasing no object marks items borrowed without keeping anything alive
+        static std::shared_ptr<void const> host_owner(void const* items, std::shared_ptr<void const> owner) {
+            return owner ? std::move(owner) : std::shared_ptr<void const>{std::shared_ptr<void const>{}, items};
+        }
+
+
+        tl::expected<symbol const*, error_info> bind_items(std::string_view name, type_tag item_tag, void const* items,
+                                                           std::size_t size, std::shared_ptr<void const> owner) {
+            try {
+                auto const item_size = item_tag == type_tag::integer ? sizeof(platform::integer) : sizeof(double);
+                auto* buffer = size == 0 ? vector_buffer::allocate(0, item_size)
+                        : vector_buffer::borrow(items, size, host_owner(items, std::move(owner)));
+                return redefine(name, value{types_.vector(type{item_tag}), buffer});
+            } catch (std::bad_alloc const&) {
+                return failed(error::not_enough_memory);
+            }
+        }
+
+
+        tl::expected<std::size_t, error_info> evaluate_items_into(std::string const& source, type_tag item_tag, void* items,
+                                                                  std::size_t capacity, std::size_t item_size) noexcept {
+            try {
+                // without cache the fragment of the expression lives for the call
+                auto fragment = std::make_unique<code_fragment>();
+                auto expression = tl::expected<ast_node*, error_info>{};
+                if(expressions_.capacity() == 0) {
+                    fragment->source = source;
+                    expression = default_module_.compile_expression(*fragment);
+                } else {
+                    expression = cached_expression(source);
+                }
+                if(!expression)
+                    return tl::make_unexpected(expression.error());
+                if((*expression)->type != types_.vector(type{item_tag}))
+                    return failed(error::result_does_not_match_buffer);
+                auto const destination = vector_reference{vector_buffer::borrow(items, 0, host_owner(items, {}))};
+                destination.get()->capacity = capacity;
+                auto const result = default_module_.evaluate_solved_expression(*expression, destination.get());
+                if(!result)
+                    return tl::make_unexpected(result.error());
+                auto const* vector = result->vector;
+                if(vector->size > capacity)
+                    return failed(error::result_does_not_match_buffer);
+                if(vector != destination.get() && vector->size != 0)
+                    std::memmove(items, vector->items<char>(), vector->size * item_size);
+                return {vector->size};
+            } catch (std::bad_alloc const&) {
+                return failed(error::not_enough_memory);
+            }
+        }
+
+
+        bool has_dependents(symbol const* s) {
+            for(auto& each_module: modules_)
+                if(each_module->dependencies_.has_dependents(s))
+                    return true;
+            return default_module_.dependencies_.has_dependents(s);
+        }
+
+
+        bool is_imported(symbol const& s) const noexcept {
+            for(auto const& each_module: modules_)
+                if(each_module->publics().find(s.name.id) == &s)
+                    return true;
+            return false;
+        }
+
     }; // engine
 
 } // namespace mandalang
\ No newline at end of file
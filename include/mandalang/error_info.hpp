@@ -1,6 +1,7 @@
 #pragma once
 
 
+#include <cstring>
 #include <system_error>
 
 #include <tl/expected.hpp>
@@ -54,7 +55,22 @@ namespace mandalang {
         condition_should_be_boolean,
         conditional_expression_types_mismatch,
         expected_left_square_brace,
-        expected_right_square_brace
+        expected_right_square_brace,
+        expected_comma_or_right_square_brace,
+        empty_vector_literal,
+        vector_items_should_have_same_type,
+        vector_items_should_be_numerical,
+        expected_definition,
+        invalid_module_image,
+        stale_module_image,
+        value_is_not_storable_in_image,
+        invalid_snapshot,
+        redefinition_changes_type,
+        vectors_should_have_same_size,
+        division_by_zero,
+        index_out_of_range,
+        result_does_not_match_buffer,
+        invalid_column_file
     }; // error
 
 
@@ -157,6 +173,36 @@ namespace mandalang {
                     return "Expected '['";
                 case error::expected_right_square_brace:
                     return "Expected ']'";
+                case error::expected_comma_or_right_square_brace:
+                    return "Expected ',' or ']'";
+                case error::empty_vector_literal:
+                    return "Vector literal should have at least one item";
+                case error::vector_items_should_have_same_type:
+                    return "Vector items should have the same type";
+                case error::vector_items_should_be_numerical:
+                    return "Vector items should be numbers or booleans";
+                case error::expected_definition:
+                    return "Expected definition";
+                case error::invalid_module_image:
+                    return "Invalid module image";
+                case error::stale_module_image:
+                    return "Module image is out of date";
+                case error::value_is_not_storable_in_image:
+                    return "Value is not storable in module image";
+                case error::invalid_snapshot:
+                    return "Invalid snapshot";
+                case error::redefinition_changes_type:
+                    return "Redefinition changes type of a value other definitions depend on";
+                case error::vectors_should_have_same_size:
+                    return "Vectors should have the same size";
+                case error::division_by_zero:
+                    return "Division by zero";
+                case error::index_out_of_range:
+                    return "Index out of range";
+                case error::result_does_not_match_buffer:
+                    return "Result does not match the type or size of the buffer";
+                case error::invalid_column_file:
+                    return "Invalid column file";
                 default:
                     return "Unknown";
             }
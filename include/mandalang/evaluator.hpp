@@ -1,13 +1,23 @@
 #pragma once
 
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
 #include <vector>
 
 #include <tl/expected.hpp>
 
 #include <mandalang/ir.hpp>
 #include <mandalang/error_info.hpp>
+#include <mandalang/thread_pool.hpp>
 #include <mandalang/type_solver.hpp>
+#include <mandalang/vector_kernels.hpp>
+#include <mandalang/vector_sort.hpp>
 
 
 
@@ -16,18 +26,43 @@ namespace mandalang {
 
     class evaluator {
     private:
-        using stack_frame = std::vector<value>;
-
-        std::vector<stack_frame> stack_;
+        // arguments of all active calls are kept in one value stack, frame_ is the
+        // base of the innermost frame, which holds arguments followed by captured values;
+        // environment_ is the one of the function the innermost frame belongs to
+        std::vector<value> stack_;
+        std::size_t frame_{0};
+        closure_environment* environment_{nullptr};
+        // buffer of the host the value of destination_node_ is written to
+        ast_node const* destination_node_{nullptr};
+        vector_buffer* destination_{nullptr};
 
     public:
 
+        // items of higher-order builtins run in parallel by chunks of at least this size,
+        // larger inputs are split to this number of chunks
+        static constexpr std::size_t parallel_chunk_size = 8192;
+        static constexpr std::size_t max_parallel_chunks = 1024;
+
         tl::expected<value, error_info> evaluate(ast_node* node) noexcept {
             switch(node->tag) {
                 case ast_node_tag::floating_point:
                     return {value{node->floating_point}};
                 case ast_node_tag::integer:
                     return {value{node->integer}};
+                case ast_node_tag::floating_point_vector:
+                case ast_node_tag::integer_vector:
+                    vector_buffer::retain(node->vector);
+                    return {value{node->type, node->vector}};
+                case ast_node_tag::vector_literal:
+                    return evaluate_vector_literal(node);
+                case ast_node_tag::local_slot:
+                    return {stack_[frame_ + node->slot.index]};
+                case ast_node_tag::last_local_slot:
+                    return {std::move(stack_[frame_ + node->slot.index])};
+                case ast_node_tag::environment_slot:
+                    return {stack_[frame_ + node->slot.index]};
+                case ast_node_tag::global_slot:
+                    return evaluate_global(node);
                 case ast_node_tag::resolved_name:
                     return evaluate_symbol(node);
                 case ast_node_tag::integer_negate:
@@ -86,10 +121,83 @@ namespace mandalang {
                     return evaluate_integer_less_or_equals(node->binary.left, node->binary.right);
                 case ast_node_tag::floating_point_less_or_equals:
                     return evaluate_floating_point_less_or_equals(node->binary.left, node->binary.right);
+                case ast_node_tag::floating_point_vector_add:
+                    return evaluate_vector_arithmetic<double>(node, vector_kernels::arithmetic::add);
+                case ast_node_tag::integer_vector_add:
+                    return evaluate_vector_arithmetic<platform::integer>(node, vector_kernels::arithmetic::add);
+                case ast_node_tag::floating_point_vector_subtract:
+                    return evaluate_vector_arithmetic<double>(node, vector_kernels::arithmetic::subtract);
+                case ast_node_tag::integer_vector_subtract:
+                    return evaluate_vector_arithmetic<platform::integer>(node, vector_kernels::arithmetic::subtract);
+                case ast_node_tag::floating_point_vector_multiply:
+                    return evaluate_vector_arithmetic<double>(node, vector_kernels::arithmetic::multiply);
+                case ast_node_tag::integer_vector_multiply:
+                    return evaluate_vector_arithmetic<platform::integer>(node, vector_kernels::arithmetic::multiply);
+                case ast_node_tag::floating_point_vector_divide:
+                    return evaluate_vector_arithmetic<double>(node, vector_kernels::arithmetic::divide);
+                case ast_node_tag::integer_vector_divide:
+                    return evaluate_vector_arithmetic<platform::integer>(node, vector_kernels::arithmetic::divide);
+                case ast_node_tag::floating_point_vector_equals_to:
+                    return evaluate_vector_comparison<double>(node, vector_kernels::comparison::equals_to);
+                case ast_node_tag::integer_vector_equals_to:
+                    return evaluate_vector_comparison<platform::integer>(node, vector_kernels::comparison::equals_to);
+                case ast_node_tag::floating_point_vector_not_equals_to:
+                    return evaluate_vector_comparison<double>(node, vector_kernels::comparison::not_equals_to);
+                case ast_node_tag::integer_vector_not_equals_to:
+                    return evaluate_vector_comparison<platform::integer>(node, vector_kernels::comparison::not_equals_to);
+                case ast_node_tag::floating_point_vector_greater_than:
+                    return evaluate_vector_comparison<double>(node, vector_kernels::comparison::greater_than);
+                case ast_node_tag::integer_vector_greater_than:
+                    return evaluate_vector_comparison<platform::integer>(node, vector_kernels::comparison::greater_than);
+                case ast_node_tag::floating_point_vector_greater_or_equals:
+                    return evaluate_vector_comparison<double>(node, vector_kernels::comparison::greater_or_equals);
+                case ast_node_tag::integer_vector_greater_or_equals:
+                    return evaluate_vector_comparison<platform::integer>(node, vector_kernels::comparison::greater_or_equals);
+                case ast_node_tag::floating_point_vector_less_than:
+                    return evaluate_vector_comparison<double>(node, vector_kernels::comparison::less_than);
+                case ast_node_tag::integer_vector_less_than:
+                    return evaluate_vector_comparison<platform::integer>(node, vector_kernels::comparison::less_than);
+                case ast_node_tag::floating_point_vector_less_or_equals:
+                    return evaluate_vector_comparison<double>(node, vector_kernels::comparison::less_or_equals);
+                case ast_node_tag::integer_vector_less_or_equals:
+                    return evaluate_vector_comparison<platform::integer>(node, vector_kernels::comparison::less_or_equals);
                 case ast_node_tag::resolved_function:
-                    return {value{node->type, node->function.body}};
+                    return evaluate_function(node);
                 case ast_node_tag::resolved_function_call:
                     return evaluate_call(node);
+                case ast_node_tag::vector_range:
+                case ast_node_tag::vector_map:
+                case ast_node_tag::vector_filter:
+                case ast_node_tag::vector_take:
+                    return evaluate_sequence(node);
+                case ast_node_tag::vector_reduce:
+                case ast_node_tag::vector_reduce_associative:
+                    return evaluate_reduce(node);
+                case ast_node_tag::vector_zip:
+                    return evaluate_zip(node);
+                case ast_node_tag::vector_sum:
+                case ast_node_tag::vector_mean:
+                case ast_node_tag::vector_norm:
+                    return evaluate_sum(node);
+                case ast_node_tag::vector_dot:
+                    return evaluate_dot(node);
+                case ast_node_tag::vector_sort:
+                case ast_node_tag::vector_argsort:
+                case ast_node_tag::vector_partial_sort:
+                case ast_node_tag::vector_nth_element:
+                case ast_node_tag::vector_lower_bound:
+                    if(node->call.arguments->binary.left->type.composite->item.tag == type_tag::floating_point)
+                        return evaluate_sorting<double>(node);
+                    return evaluate_sorting<platform::integer>(node);
+                case ast_node_tag::vector_set:
+                case ast_node_tag::vector_append:
+                    return node->type.is_persistent() ? evaluate_persistent(node) : evaluate_update(node);
+                case ast_node_tag::vector_slice:
+                case ast_node_tag::vector_concat:
+                    return node->type.is_persistent() ? evaluate_persistent(node) : evaluate_slice_or_concat(node);
+                case ast_node_tag::vector_to_persistent:
+                case ast_node_tag::persistent_to_vector:
+                    return evaluate_persistent(node);
                 case ast_node_tag::conditional:
                     return evaluate_conditional(node);
                 default:
@@ -97,22 +205,94 @@ namespace mandalang {
             }
         }
 
+
+        // items of a vector value of node are made in destination when it is large enough,
+        // the result refers to destination then
+        tl::expected<value, error_info> evaluate(ast_node* node, vector_buffer* destination) noexcept {
+            destination_node_ = node;
+            destination_ = destination;
+            auto result = evaluate(node);
+            destination_node_ = nullptr;
+            destination_ = nullptr;
+            return result;
+        }
+
     private:
 
 
         tl::expected<value, error_info> evaluate_symbol(ast_node* node) {
             switch(node->resolved_name->tag) {
-                case symbol_tag::fn_parameter:
-                    if(stack_.empty())
-                        return failed(error::invalid_stack_operation, node->line_no);
-                    return evaluate_function_parameter(node->resolved_name);
                 case symbol_tag::expression:
                     return evaluate(node->resolved_name->expression);
-                case symbol_tag::value:
-                    return {node->resolved_name->value};
                 default:
-                    return failed(error::invalid_symbol, node->resolved_name->name);
+                    return failed(error::invalid_symbol, node->resolved_name->name.text);
+            }
+        }
+
+
+        tl::expected<value, error_info> evaluate_vector_literal(ast_node* node) {
+            auto const item_tag = node->type.composite->item.tag;
+            auto result = value{node->type, vector_buffer::allocate(node->vector_literal.size, vector_item_size(node->type))};
+            auto* buffer = result.vector;
+            for(auto* item = node->vector_literal.items; item != nullptr; item = item->binary.right) {
+                auto const expected_item = evaluate(item->binary.left);
+                if(!expected_item)
+                    return expected_item;
+                if(item_tag == type_tag::floating_point)
+                    buffer->items<double>()[buffer->size++] = expected_item->floating_point;
+                else if(item_tag == type_tag::boolean)
+                    buffer->items<bool>()[buffer->size++] = expected_item->boolean;
+                else
+                    buffer->items<platform::integer>()[buffer->size++] = expected_item->integer;
             }
+            return {std::move(result)};
+        }
+
+
+        // element-wise operations write to an operand referenced by nothing else,
+        // otherwise to a new vector of the same size as operands
+        template<typename T> tl::expected<value, error_info> evaluate_vector_arithmetic(ast_node* node,
+                                                                                     vector_kernels::arithmetic op) {
+            auto expected_left = evaluate(node->binary.left);
+            if(!expected_left)
+                return expected_left;
+            auto expected_right = evaluate(node->binary.right);
+            if(!expected_right)
+                return expected_right;
+            auto const* left = expected_left->vector;
+            auto const* right = expected_right->vector;
+            if(left->size != right->size)
+                return failed(error::vectors_should_have_same_size, node->line_no);
+            if constexpr(std::is_integral_v<T>)
+                if(op == vector_kernels::arithmetic::divide
+                   && std::find(right->items<T>(), right->items<T>() + right->size, T(0)) != right->items<T>() + right->size)
+                    return failed(error::division_by_zero, node->line_no);
+            auto result = node == destination_node_ ? result_vector(node, left->size, sizeof(T))
+                    : unique(left) ? std::move(*expected_left)
+                    : unique(right) ? std::move(*expected_right)
+                    : result_vector(node, left->size, sizeof(T));
+            vector_kernels::apply(op, left->items<T>(), right->items<T>(), result.vector->items<T>(), left->size);
+            result.vector->size = left->size;
+            return {std::move(result)};
+        }
+
+
+        template<typename T> tl::expected<value, error_info> evaluate_vector_comparison(ast_node* node,
+                                                                                     vector_kernels::comparison op) {
+            auto const expected_left = evaluate(node->binary.left);
+            if(!expected_left)
+                return expected_left;
+            auto const expected_right = evaluate(node->binary.right);
+            if(!expected_right)
+                return expected_right;
+            auto const* left = expected_left->vector;
+            auto const* right = expected_right->vector;
+            if(left->size != right->size)
+                return failed(error::vectors_should_have_same_size, node->line_no);
+            auto result = value{node->type, vector_buffer::allocate(left->size, sizeof(bool))};
+            vector_kernels::compare(op, left->items<T>(), right->items<T>(), result.vector->items<bool>(), left->size);
+            result.vector->size = left->size;
+            return {std::move(result)};
         }
 
 
@@ -402,35 +582,67 @@ namespace mandalang {
         }
 
 
-        tl::expected<value, error_info> evaluate_function_parameter(symbol const* symbol) {
-            auto const& parameter = symbol->function_parameter;
-            auto const& stack_frame = stack_[stack_.size() - 1 - parameter.depth];
-            return {stack_frame[parameter.index]};
+        // self of a function which captures values is bound to the function being called
+        tl::expected<value, error_info> evaluate_global(ast_node* node) {
+            auto const& global = *node->slot.global;
+            if(!global.type.is_function() || global.function.native == nullptr || global.function.environment != nullptr
+               || global.function.native->function.captures == nullptr)
+                return {global};
+            closure_environment::retain(environment_);
+            return {value{global.type, global.function.native, environment_}};
+        }
+
+
+        tl::expected<value, error_info> evaluate_function(ast_node* node) {
+            if(node->function.captures == nullptr)
+                return {value{node->type, node}};
+            auto* environment = new closure_environment{1, {}};
+            auto made = value{node->type, node, environment};
+            for(auto* capture = node->function.captures; capture != nullptr; capture = capture->binary.right) {
+                auto expected_captured = evaluate(capture->binary.left);
+                if(!expected_captured)
+                    return expected_captured;
+                environment->captured.push_back(std::move(*expected_captured));
+            }
+            return {std::move(made)};
         }
 
 
         tl::expected<value, error_info> evaluate_call(ast_node* node) {
-            auto expected_callee = evaluate_callee(node->call.callee);
+            auto const expected_callee = evaluate(node->call.callee);
             if(!expected_callee)
-                return tl::make_unexpected(expected_callee.error());
-            if(node->call.arguments_count != 0) {
-                auto expected_arguments = evaluate_arguments(node->call.arguments);
-                if(!expected_arguments)
-                    return tl::make_unexpected(expected_arguments.error());
-                if(expected_callee->native) {
-                    stack_.emplace_back(std::move(*expected_arguments));
-                    auto const expected_result = evaluate(expected_callee->native);
-                    stack_.pop_back();
-                    return expected_result;
-                } else {
-                    return expected_callee->builtin(*expected_arguments);
+                return expected_callee;
+            auto const base = stack_.size();
+            for(auto* argument = node->call.arguments; argument != nullptr; argument = argument->binary.right) {
+                auto expected_argument = evaluate(argument->binary.left);
+                if(!expected_argument) {
+                    stack_.resize(base);
+                    return expected_argument;
                 }
-            } else {
-                if (expected_callee->native)
-                    return evaluate(expected_callee->native);
-                else
-                    return expected_callee->builtin(std::vector<value>{});
+                stack_.emplace_back(std::move(*expected_argument));
             }
+            return call(expected_callee->function, base);
+        }
+
+
+        // calls a function with arguments pushed to the stack from base, arguments are popped
+        tl::expected<value, error_info> call(function_value const& callee, std::size_t base) {
+            if(!callee.native) {
+                auto const arguments = std::vector<value>(stack_.begin() + base, stack_.end());
+                stack_.resize(base);
+                return callee.builtin(arguments);
+            }
+            if(callee.environment != nullptr)
+                stack_.insert(stack_.end(), callee.environment->captured.begin(), callee.environment->captured.end());
+            auto const outer_frame = frame_;
+            auto* const outer_environment = environment_;
+            frame_ = base;
+            environment_ = callee.environment;
+            auto expected_result = evaluate(callee.native->function.body);
+            environment_ = outer_environment;
+            frame_ = outer_frame;
+            stack_.resize(base);
+            return expected_result;
         }
 
 
@@ -442,46 +654,699 @@ namespace mandalang {
         }
 
 
-        tl::expected<function_value, error_info> evaluate_callee(ast_node* callee) {
-            if(callee->tag == ast_node_tag::resolved_name)
-                return callee->resolved_name->value.function;
-            while(callee != nullptr) {
-                switch(callee->tag) {
-                    case ast_node_tag::resolved_name:
-                        return {callee->resolved_name->value.function};
-                    case ast_node_tag::resolved_function:
-                        return {function_value{callee->function.body, nullptr}};
-                    case ast_node_tag::resolved_function_call:
-                        return evaluate_callee_call(callee);
-                    case ast_node_tag::subexpression:
-                        callee = callee->unary;
+        static value item(vector_buffer const* vector, type_tag tag, std::size_t index) noexcept {
+            switch(tag) {
+                case type_tag::floating_point:
+                    return value{vector->items<double>()[index]};
+                case type_tag::boolean:
+                    return value{vector->items<bool>()[index]};
+                default:
+                    return value{vector->items<platform::integer>()[index]};
+            }
+        }
+
+
+        static void const* item_bytes(value const& item) noexcept {
+            switch(item.type.tag) {
+                case type_tag::floating_point:
+                    return &item.floating_point;
+                case type_tag::boolean:
+                    return &item.boolean;
+                default:
+                    return &item.integer;
+            }
+        }
+
+
+        static void store(vector_buffer* vector, type_tag tag, std::size_t index, value const& item) noexcept {
+            switch(tag) {
+                case type_tag::floating_point:
+                    vector->items<double>()[index] = item.floating_point;
+                    return;
+                case type_tag::boolean:
+                    vector->items<bool>()[index] = item.boolean;
+                    return;
+                default:
+                    vector->items<platform::integer>()[index] = item.integer;
+                    return;
+            }
+        }
+
+
+        // chunks depend on the count of items only, so results do not depend on threads
+        static std::size_t chunk_size(std::size_t count) noexcept {
+            return std::max(parallel_chunk_size, (count + max_parallel_chunks - 1) / max_parallel_chunks);
+        }
+
+
+        static std::size_t chunks_count(std::size_t count) noexcept {
+            auto const size = chunk_size(count);
+            return (count + size - 1) / size;
+        }
+
+
+        // runs body(evaluator, begin, end) over chunks of items; when allowed, chunks run on shared
+        // workers with evaluators of their own, otherwise body gets all items at once;
+        // the first failed chunk is reported
+        template<typename F> tl::expected<void, error_info> for_each_chunk(bool parallel, std::size_t count,
+                                                                          F const& body) {
+            auto const size = chunk_size(count);
+            auto const chunks = chunks_count(count);
+            if(chunks < 2 || !parallel || thread_pool::shared().size() < 2)
+                return body(*this, 0, count);
+            auto results = std::vector<tl::expected<void, error_info>>(chunks);
+            thread_pool::shared().fork_join(chunks, [&](std::size_t chunk) {
+                try {
+                    evaluator chunk_evaluator;
+                    results[chunk] = body(chunk_evaluator, chunk * size, std::min(count, (chunk + 1) * size));
+                } catch(std::bad_alloc const&) {
+                    results[chunk] = failed(error::not_enough_memory);
+                }
+            });
+            for(auto const& result: results)
+                if(!result)
+                    return result;
+            return {};
+        }
+
+
+        // range, map, filter and take are lazy: nested calls of them are fused into one pipeline
+        // which pulls items of a range or a vector through all stages, so no intermediate
+        // vectors are made and a reduction of a pipeline takes constant memory
+        struct pipeline {
+            struct stage {
+                ast_node_tag tag;
+                value function;
+                std::size_t limit;
+            };
+
+            value vector;
+            platform::integer first{0};
+            std::size_t size{0};
+            std::vector<stage> stages;
+            bool filtered{false};
+            bool limited{false};
+
+            value item(std::size_t index) const noexcept {
+                if(!vector.type.is_vector())
+                    return value{platform::integer(first + platform::integer(index))};
+                return evaluator::item(vector.vector, vector.type.composite->item.tag, index);
+            }
+
+            // items past a take stage depend on the items before them
+            bool parallel() const noexcept {
+                return !limited;
+            }
+        }; // pipeline
+
+
+        static bool lazy(ast_node const* node) noexcept {
+            switch(node->tag) {
+                case ast_node_tag::vector_range:
+                case ast_node_tag::vector_map:
+                case ast_node_tag::vector_filter:
+                case ast_node_tag::vector_take:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+
+        // stages are collected from the source outwards, so they are kept in the order they run
+        tl::expected<void, error_info> build_pipeline(ast_node* node, pipeline& p) {
+            if(!lazy(node)) {
+                auto expected_vector = evaluate(node);
+                if(!expected_vector)
+                    return tl::make_unexpected(expected_vector.error());
+                p.vector = std::move(*expected_vector);
+                p.size = p.vector.vector->size;
+                return {};
+            }
+            auto const* arguments = node->call.arguments;
+            switch(node->tag) {
+                case ast_node_tag::vector_range: {
+                    auto const expected_first = evaluate(arguments->binary.left);
+                    if(!expected_first)
+                        return tl::make_unexpected(expected_first.error());
+                    auto const expected_last = evaluate(arguments->binary.right->binary.left);
+                    if(!expected_last)
+                        return tl::make_unexpected(expected_last.error());
+                    p.first = expected_first->integer;
+                    p.size = expected_last->integer > p.first ? std::size_t(expected_last->integer - p.first) : 0;
+                    return {};
+                }
+                case ast_node_tag::vector_take: {
+                    auto const built = build_pipeline(arguments->binary.left, p);
+                    if(!built)
+                        return built;
+                    auto const expected_limit = evaluate(arguments->binary.right->binary.left);
+                    if(!expected_limit)
+                        return tl::make_unexpected(expected_limit.error());
+                    auto const limit = expected_limit->integer > 0 ? std::size_t(expected_limit->integer) : 0;
+                    p.stages.push_back({node->tag, {}, limit});
+                    p.limited = true;
+                    return {};
+                }
+                default: {
+                    auto const expected_function = evaluate(arguments->binary.left);
+                    if(!expected_function)
+                        return tl::make_unexpected(expected_function.error());
+                    auto const built = build_pipeline(arguments->binary.right->binary.left, p);
+                    if(!built)
+                        return built;
+                    p.stages.push_back({node->tag, std::move(*expected_function), 0});
+                    p.filtered = p.filtered || node->tag == ast_node_tag::vector_filter;
+                    return {};
+                }
+            }
+        }
+
+
+        // pushes source items from begin to end through the stages, items passing all of them go
+        // to sink(index, item); stops once a take stage has all its items
+        template<typename Sink> tl::expected<void, error_info> pull(pipeline const& p, std::size_t begin,
+                                                                   std::size_t end, Sink const& sink) {
+            auto taken = std::vector<std::size_t>(p.stages.size());
+            for(auto const& each_stage: p.stages)
+                if(each_stage.tag == ast_node_tag::vector_take && each_stage.limit == 0)
+                    return {};
+            auto const base = stack_.size();
+            for(auto i = begin; i != end; ++i) {
+                auto item = p.item(i);
+                auto passed = true;
+                auto exhausted = false;
+                for(auto k = std::size_t(0); passed && k != p.stages.size(); ++k) {
+                    auto const& each_stage = p.stages[k];
+                    if(each_stage.tag == ast_node_tag::vector_take) {
+                        exhausted = exhausted || ++taken[k] == each_stage.limit;
                         continue;
-                    default:
-                        return failed(error::invalid_ast_node_to_evaluate, callee->line_no);
+                    }
+                    stack_.push_back(item);
+                    auto expected_item = call(each_stage.function.function, base);
+                    if(!expected_item)
+                        return tl::make_unexpected(expected_item.error());
+                    if(each_stage.tag == ast_node_tag::vector_map)
+                        item = std::move(*expected_item);
+                    else
+                        passed = expected_item->boolean;
                 }
+                if(!passed)
+                    continue;
+                auto const sunk = sink(i, std::move(item));
+                if(!sunk)
+                    return sunk;
+                if(exhausted)
+                    return {};
+            }
+            return {};
+        }
+
+
+        static void append(value& vector, type_tag tag, std::size_t item_size, value const& item) {
+            auto* buffer = vector.vector;
+            if(buffer->size == buffer->capacity) {
+                auto* grown = buffer->grow(std::max<std::size_t>(16, buffer->capacity * 2), item_size);
+                vector_buffer::release(buffer);
+                vector.vector = buffer = grown;
+            }
+            store(buffer, tag, buffer->size++, item);
+        }
+
+
+        // a pipeline ending where a vector is needed makes only the resulting vector; without
+        // filter and take stages items land at their source index, otherwise every chunk
+        // collects its items apart and chunks are joined in order
+        tl::expected<value, error_info> evaluate_sequence(ast_node* node) {
+            auto p = pipeline{};
+            auto const built = build_pipeline(node, p);
+            if(!built)
+                return tl::make_unexpected(built.error());
+            auto const tag = node->type.composite->item.tag;
+            auto const item_size = vector_item_size(node->type);
+            if(!p.filtered && !p.limited) {
+                auto result = result_vector(node, p.size, item_size);
+                auto* target = result.vector;
+                auto const pulled = for_each_chunk(p.parallel(), p.size,
+                        [&](evaluator& e, std::size_t begin, std::size_t end) {
+                    return e.pull(p, begin, end, [&](std::size_t index, value&& item) -> tl::expected<void, error_info> {
+                        store(target, tag, index, item);
+                        return {};
+                    });
+                });
+                if(!pulled)
+                    return tl::make_unexpected(pulled.error());
+                target->size = p.size;
+                return {std::move(result)};
+            }
+            auto const size = chunk_size(p.size);
+            auto parts = std::vector<value>(p.parallel() ? std::max<std::size_t>(1, chunks_count(p.size)) : 1);
+            for(auto& part: parts)
+                part = value{node->type, vector_buffer::allocate(0, item_size)};
+            auto const pulled = for_each_chunk(p.parallel(), p.size,
+                    [&](evaluator& e, std::size_t begin, std::size_t end) {
+                auto& part = parts[parts.size() == 1 ? 0 : begin / size];
+                return e.pull(p, begin, end, [&](std::size_t, value&& item) -> tl::expected<void, error_info> {
+                    append(part, tag, item_size, item);
+                    return {};
+                });
+            });
+            if(!pulled)
+                return tl::make_unexpected(pulled.error());
+            if(parts.size() == 1)
+                return {std::move(parts.front())};
+            auto count = std::size_t(0);
+            for(auto const& part: parts)
+                count += part.vector->size;
+            auto result = value{node->type, vector_buffer::allocate(count, item_size)};
+            for(auto const& part: parts) {
+                std::memcpy(result.vector->items<char>() + result.vector->size * item_size,
+                            part.vector->items<char>(), part.vector->size * item_size);
+                result.vector->size += part.vector->size;
             }
-            return failed(error::invalid_ast_node_to_evaluate, callee->line_no);
+            return {std::move(result)};
         }
 
 
-        tl::expected<function_value, error_info> evaluate_callee_call(ast_node* callee) {
-            auto expected_function = evaluate_call(callee);
+        // zip(f, u, v) maps items of two vectors of the same size
+        tl::expected<value, error_info> evaluate_zip(ast_node* node) {
+            auto const* arguments = node->call.arguments;
+            auto const expected_function = evaluate(arguments->binary.left);
             if(!expected_function)
-                return tl::make_unexpected(expected_function.error());
-            return {expected_function->function};
+                return expected_function;
+            auto const expected_left = evaluate(arguments->binary.right->binary.left);
+            if(!expected_left)
+                return expected_left;
+            auto const expected_right = evaluate(arguments->binary.right->binary.right->binary.left);
+            if(!expected_right)
+                return expected_right;
+            auto const& callee = expected_function->function;
+            auto const* left = expected_left->vector;
+            auto const* right = expected_right->vector;
+            if(left->size != right->size)
+                return failed(error::vectors_should_have_same_size, node->line_no);
+            auto const left_tag = expected_left->type.composite->item.tag;
+            auto const right_tag = expected_right->type.composite->item.tag;
+            auto const result_tag = node->type.composite->item.tag;
+            auto result = result_vector(node, left->size, vector_item_size(node->type));
+            auto* target = result.vector;
+            auto const zipped = for_each_chunk(true, left->size,
+                    [&](evaluator& e, std::size_t begin, std::size_t end) -> tl::expected<void, error_info> {
+                auto const base = e.stack_.size();
+                for(auto i = begin; i != end; ++i) {
+                    e.stack_.push_back(item(left, left_tag, i));
+                    e.stack_.push_back(item(right, right_tag, i));
+                    auto const expected_item = e.call(callee, base);
+                    if(!expected_item)
+                        return tl::make_unexpected(expected_item.error());
+                    store(target, result_tag, i, *expected_item);
+                }
+                return {};
+            });
+            if(!zipped)
+                return tl::make_unexpected(zipped.error());
+            target->size = left->size;
+            return {std::move(result)};
         }
 
 
-        tl::expected<std::vector<value>, error_info> evaluate_arguments(ast_node* argument) {
-            std::vector<value> arguments;
-            while(argument != nullptr) {
-                auto expected_argument = evaluate(argument->binary.left);
-                if(!expected_argument)
-                    return tl::make_unexpected(expected_argument.error());
-                arguments.emplace_back(std::move(*expected_argument));
-                argument = argument->binary.right;
+
+        // reduce(f, init, v) folds items from the left, a pipeline in place of v is folded as its
+        // items are pulled; reduce_associative(f, init, v) folds chunks apart and combines their
+        // results as a tree of a shape fixed by the source size, then folds init with the
+        // combined result, which is the left fold only when f is associative
+        tl::expected<value, error_info> evaluate_reduce(ast_node* node) {
+            auto const* arguments = node->call.arguments;
+            auto const expected_function = evaluate(arguments->binary.left);
+            if(!expected_function)
+                return expected_function;
+            auto expected_initial = evaluate(arguments->binary.right->binary.left);
+            if(!expected_initial)
+                return expected_initial;
+            auto* items = arguments->binary.right->binary.right->binary.left;
+            auto p = pipeline{};
+            auto const built = build_pipeline(items, p);
+            if(!built)
+                return tl::make_unexpected(built.error());
+            auto const& callee = expected_function->function;
+            auto const fold = [&callee](evaluator& e, value& accumulated, value&& item) -> tl::expected<void, error_info> {
+                auto const base = e.stack_.size();
+                e.stack_.push_back(std::move(accumulated));
+                e.stack_.push_back(std::move(item));
+                auto expected_accumulated = e.call(callee, base);
+                if(!expected_accumulated)
+                    return tl::make_unexpected(expected_accumulated.error());
+                accumulated = std::move(*expected_accumulated);
+                return {};
+            };
+            auto const size = chunk_size(p.size);
+            auto const chunks = chunks_count(p.size);
+            if(node->tag != ast_node_tag::vector_reduce_associative || chunks < 2 || !p.parallel()) {
+                auto accumulated = std::move(*expected_initial);
+                auto const pulled = pull(p, 0, p.size, [&](std::size_t, value&& item) {
+                    return fold(*this, accumulated, std::move(item));
+                });
+                if(!pulled)
+                    return tl::make_unexpected(pulled.error());
+                return {std::move(accumulated)};
+            }
+            auto partials = std::vector<std::optional<value>>(chunks);
+            auto const folded = for_each_chunk(true, p.size,
+                    [&](evaluator& e, std::size_t begin, std::size_t end) -> tl::expected<void, error_info> {
+                for(; begin != end; begin = std::min(end, begin + size)) {
+                    auto& partial = partials[begin / size];
+                    auto const pulled = e.pull(p, begin, std::min(end, begin + size),
+                                               [&](std::size_t, value&& item) -> tl::expected<void, error_info> {
+                        if(!partial) {
+                            partial = std::move(item);
+                            return {};
+                        }
+                        return fold(e, *partial, std::move(item));
+                    });
+                    if(!pulled)
+                        return pulled;
+                }
+                return {};
+            });
+            if(!folded)
+                return tl::make_unexpected(folded.error());
+            auto combined = std::vector<value>{};
+            for(auto& partial: partials)
+                if(partial)
+                    combined.push_back(std::move(*partial));
+            while(combined.size() > 1) {
+                auto next = std::vector<value>{};
+                next.reserve((combined.size() + 1) / 2);
+                for(auto i = std::size_t(0); i + 1 < combined.size(); i += 2) {
+                    auto const combined_pair = fold(*this, combined[i], std::move(combined[i + 1]));
+                    if(!combined_pair)
+                        return tl::make_unexpected(combined_pair.error());
+                    next.push_back(std::move(combined[i]));
+                }
+                if(combined.size() % 2 != 0)
+                    next.push_back(std::move(combined.back()));
+                combined = std::move(next);
+            }
+            auto accumulated = std::move(*expected_initial);
+            if(!combined.empty()) {
+                auto const folded_last = fold(*this, accumulated, std::move(combined.front()));
+                if(!folded_last)
+                    return tl::make_unexpected(folded_last.error());
+            }
+            return {std::move(accumulated)};
+        }
+
+
+
+        // chunk sums are combined as a tree of a shape fixed by the chunks count
+        static vector_kernels::compensated_sum combine(std::vector<vector_kernels::compensated_sum>& partials) noexcept {
+            for(auto width = std::size_t(1); width < partials.size(); width *= 2)
+                for(auto i = std::size_t(0); i + width < partials.size(); i += 2 * width)
+                    partials[i].add(partials[i + width]);
+            return partials.empty() ? vector_kernels::compensated_sum{} : partials.front();
+        }
+
+
+        // sum, mean and norm add items, or their squares, by chunks of a size fixed by the count of
+        // source items, so results are the same bits on any number of threads; vectors are summed
+        // by compensated kernels, pipelines as their items are pulled
+        tl::expected<value, error_info> evaluate_sum(ast_node* node) {
+            auto p = pipeline{};
+            auto const built = build_pipeline(node->call.arguments->binary.left, p);
+            if(!built)
+                return tl::make_unexpected(built.error());
+            auto const squares = node->tag == ast_node_tag::vector_norm;
+            auto const size = chunk_size(p.size);
+            auto partials = std::vector<vector_kernels::compensated_sum>(chunks_count(p.size));
+            auto counts = std::vector<std::size_t>(partials.size());
+            auto const add = [&](std::size_t index, value&& item) -> tl::expected<void, error_info> {
+                auto const chunk = index / size;
+                partials[chunk].add(squares ? item.floating_point * item.floating_point : item.floating_point);
+                ++counts[chunk];
+                return {};
+            };
+            // take stages count items from the start of the source, so such a pipeline is pulled at once
+            auto const summed = !p.parallel() ? pull(p, 0, p.size, add) : for_each_chunk(true, p.size,
+                    [&](evaluator& e, std::size_t begin, std::size_t end) -> tl::expected<void, error_info> {
+                for(; begin != end; begin = std::min(end, begin + size)) {
+                    auto const chunk = begin / size;
+                    auto const chunk_end = std::min(end, begin + size);
+                    if(p.stages.empty()) {
+                        auto const* items = p.vector.vector->items<double>() + begin;
+                        partials[chunk] = squares
+                                ? vector_kernels::dot(items, items, chunk_end - begin)
+                                : vector_kernels::sum(items, chunk_end - begin);
+                        counts[chunk] = chunk_end - begin;
+                        continue;
+                    }
+                    auto const pulled = e.pull(p, begin, chunk_end, add);
+                    if(!pulled)
+                        return pulled;
+                }
+                return {};
+            });
+            if(!summed)
+                return tl::make_unexpected(summed.error());
+            auto const total = combine(partials).value();
+            switch(node->tag) {
+                case ast_node_tag::vector_mean: {
+                    auto count = std::size_t(0);
+                    for(auto const each_count: counts)
+                        count += each_count;
+                    return {value{total / double(count)}};
+                }
+                case ast_node_tag::vector_norm:
+                    return {value{std::sqrt(total)}};
+                default:
+                    return {value{total}};
+            }
+        }
+
+
+        tl::expected<value, error_info> evaluate_dot(ast_node* node) {
+            auto const expected_left = evaluate(node->call.arguments->binary.left);
+            if(!expected_left)
+                return expected_left;
+            auto const expected_right = evaluate(node->call.arguments->binary.right->binary.left);
+            if(!expected_right)
+                return expected_right;
+            auto const* left = expected_left->vector;
+            auto const* right = expected_right->vector;
+            if(left->size != right->size)
+                return failed(error::vectors_should_have_same_size, node->line_no);
+            auto const size = chunk_size(left->size);
+            auto partials = std::vector<vector_kernels::compensated_sum>(chunks_count(left->size));
+            auto const summed = for_each_chunk(true, left->size,
+                    [&](evaluator&, std::size_t begin, std::size_t end) -> tl::expected<void, error_info> {
+                for(; begin != end; begin = std::min(end, begin + size))
+                    partials[begin / size] = vector_kernels::dot(left->items<double>() + begin, right->items<double>() + begin,
+                                                                 std::min(end, begin + size) - begin);
+                return {};
+            });
+            if(!summed)
+                return tl::make_unexpected(summed.error());
+            return {value{combine(partials).value()}};
+        }
+
+
+
+        // destination is written to though it is borrowed, it is given to be written
+        value result_vector(ast_node const* node, std::size_t size, std::size_t item_size) {
+            if(node != destination_node_ || destination_->capacity < size)
+                return value{node->type, vector_buffer::allocate(size, item_size)};
+            vector_buffer::retain(destination_);
+            destination_->size = 0;
+            return value{node->type, destination_};
+        }
+
+
+        // a vector referenced by one value only may be changed in place, as no one else sees it
+        static bool unique(vector_buffer const* buffer) noexcept {
+            return buffer->references.load(std::memory_order_acquire) == 1 && !buffer->borrowed();
+        }
+
+
+        // items of a vector referenced by this value only are changed in place, other vectors are copied
+        static value owned(value&& vector, std::size_t item_size) {
+            auto const* buffer = vector.vector;
+            if(unique(buffer))
+                return std::move(vector);
+            return value{vector.type, buffer->grow(buffer->size, item_size)};
+        }
+
+
+        // set and append copy a shared vector, so a vector passed on as the last read of
+        // a parameter or as a temporary is updated in place
+        tl::expected<value, error_info> evaluate_update(ast_node* node) {
+            auto expected_vector = evaluate(node->call.arguments->binary.left);
+            if(!expected_vector)
+                return expected_vector;
+            auto const* rest = node->call.arguments->binary.right;
+            auto const tag = node->type.composite->item.tag;
+            auto const item_size = vector_item_size(node->type);
+            auto const size = expected_vector->vector->size;
+            if(node->tag == ast_node_tag::vector_set) {
+                auto const expected_index = evaluate(rest->binary.left);
+                if(!expected_index)
+                    return expected_index;
+                auto const index = expected_index->integer;
+                if(index < 0 || std::size_t(index) >= size)
+                    return failed(error::index_out_of_range, node->line_no);
+                auto const expected_item = evaluate(rest->binary.right->binary.left);
+                if(!expected_item)
+                    return expected_item;
+                auto result = owned(std::move(*expected_vector), item_size);
+                store(result.vector, tag, std::size_t(index), *expected_item);
+                return {std::move(result)};
+            }
+            auto const expected_item = evaluate(rest->binary.left);
+            if(!expected_item)
+                return expected_item;
+            auto result = unique(expected_vector->vector)
+                    ? std::move(*expected_vector)
+                    : value{node->type, expected_vector->vector->grow(std::max<std::size_t>(16, size * 2), item_size)};
+            append(result, tag, item_size, *expected_item);
+            return {std::move(result)};
+        }
+
+
+        // slices of flat vectors copy items, concatenation appends to a left vector
+        // referenced by nothing else when it has room
+        tl::expected<value, error_info> evaluate_slice_or_concat(ast_node* node) {
+            auto expected_vector = evaluate(node->call.arguments->binary.left);
+            if(!expected_vector)
+                return expected_vector;
+            auto const* rest = node->call.arguments->binary.right;
+            auto const expected_argument = evaluate(rest->binary.left);
+            if(!expected_argument)
+                return expected_argument;
+            auto const item_size = vector_item_size(node->type);
+            auto const size = expected_vector->vector->size;
+            if(node->tag == ast_node_tag::vector_concat) {
+                auto const* right = expected_argument->vector;
+                auto const total = size + right->size;
+                auto result = unique(expected_vector->vector) && expected_vector->vector->capacity >= total
+                        ? std::move(*expected_vector)
+                        : value{node->type, expected_vector->vector->grow(total, item_size)};
+                std::memcpy(result.vector->items<char>() + size * item_size, right->items<char>(), right->size * item_size);
+                result.vector->size = total;
+                return {std::move(result)};
+            }
+            auto const expected_end = evaluate(rest->binary.right->binary.left);
+            if(!expected_end)
+                return expected_end;
+            auto const begin = expected_argument->integer;
+            auto const end = expected_end->integer;
+            if(begin < 0 || begin > end || std::size_t(end) > size)
+                return failed(error::index_out_of_range, node->line_no);
+            auto result = value{node->type, vector_buffer::allocate(std::size_t(end - begin), item_size)};
+            std::memcpy(result.vector->items<char>(), expected_vector->vector->items<char>() + begin * item_size,
+                        std::size_t(end - begin) * item_size);
+            result.vector->size = std::size_t(end - begin);
+            return {std::move(result)};
+        }
+
+
+        // a persistent vector made by an update shares all nodes with its source but the
+        // copied path, so both stay usable and cost O(log n) to make
+        tl::expected<value, error_info> evaluate_persistent(ast_node* node) {
+            auto const expected_source = evaluate(node->call.arguments->binary.left);
+            if(!expected_source)
+                return expected_source;
+            auto const item_size = vector_item_size(node->type);
+            if(node->tag == ast_node_tag::vector_to_persistent) {
+                auto const* vector = expected_source->vector;
+                return {value{node->type, persistent_vector::build(vector->items<char>(), vector->size, item_size).detach()}};
+            }
+            auto* root = expected_source->persistent;
+            auto const size = persistent_vector::size_of(root);
+            if(node->tag == ast_node_tag::persistent_to_vector) {
+                auto result = value{node->type, vector_buffer::allocate(size, item_size)};
+                persistent_vector::copy_items(root, result.vector->items<char>(), item_size);
+                result.vector->size = size;
+                return {std::move(result)};
+            }
+            auto const* rest = node->call.arguments->binary.right;
+            auto const expected_argument = evaluate(rest->binary.left);
+            if(!expected_argument)
+                return expected_argument;
+            switch(node->tag) {
+                case ast_node_tag::vector_append:
+                    return {value{node->type, persistent_vector::push(root, item_bytes(*expected_argument), item_size).detach()}};
+                case ast_node_tag::vector_concat:
+                    return {value{node->type, persistent_vector::join(root, expected_argument->persistent, item_size).detach()}};
+                default:
+                    break;
+            }
+            auto const expected_last = evaluate(rest->binary.right->binary.left);
+            if(!expected_last)
+                return expected_last;
+            if(node->tag == ast_node_tag::vector_set) {
+                auto const index = expected_argument->integer;
+                if(index < 0 || std::size_t(index) >= size)
+                    return failed(error::index_out_of_range, node->line_no);
+                return {value{node->type, persistent_vector::set(root, std::size_t(index), item_bytes(*expected_last),
+                                                                 item_size).detach()}};
+            }
+            auto const begin = expected_argument->integer;
+            auto const end = expected_last->integer;
+            if(begin < 0 || begin > end || std::size_t(end) > size)
+                return failed(error::index_out_of_range, node->line_no);
+            return {value{node->type, persistent_vector::slice(root, std::size_t(begin), std::size_t(end), item_size).detach()}};
+        }
+
+
+        template<typename T> tl::expected<value, error_info> evaluate_sorting(ast_node* node) {
+            auto expected_vector = evaluate(node->call.arguments->binary.left);
+            if(!expected_vector)
+                return expected_vector;
+            auto const order = vector_sort::less<T>{};
+            auto const size = expected_vector->vector->size;
+            switch(node->tag) {
+                case ast_node_tag::vector_sort: {
+                    auto result = owned(std::move(*expected_vector), sizeof(T));
+                    auto const scratch = std::make_unique_for_overwrite<T[]>(size);
+                    vector_sort::sort(result.vector->items<T>(), scratch.get(), size);
+                    return {std::move(result)};
+                }
+                case ast_node_tag::vector_argsort: {
+                    auto result = value{node->type, vector_buffer::allocate(size, sizeof(platform::integer))};
+                    auto const scratch = std::make_unique_for_overwrite<platform::integer[]>(size);
+                    vector_sort::argsort(expected_vector->vector->template items<T>(), result.vector->items<platform::integer>(),
+                                         scratch.get(), size);
+                    result.vector->size = size;
+                    return {std::move(result)};
+                }
+                default:
+                    break;
+            }
+            auto const expected_argument = evaluate(node->call.arguments->binary.right->binary.left);
+            if(!expected_argument)
+                return expected_argument;
+            auto const* items = expected_vector->vector->template items<T>();
+            switch(node->tag) {
+                case ast_node_tag::vector_partial_sort: {
+                    auto const count = std::clamp<platform::integer>(expected_argument->integer, 0, platform::integer(size));
+                    auto result = value{node->type, vector_buffer::allocate(std::size_t(count), sizeof(T))};
+                    std::partial_sort_copy(items, items + size, result.vector->items<T>(), result.vector->items<T>() + count, order);
+                    result.vector->size = std::size_t(count);
+                    return {std::move(result)};
+                }
+                case ast_node_tag::vector_nth_element: {
+                    auto const index = expected_argument->integer;
+                    if(index < 0 || std::size_t(index) >= size)
+                        return failed(error::index_out_of_range, node->line_no);
+                    auto const selected = owned(std::move(*expected_vector), sizeof(T));
+                    auto* selected_items = selected.vector->items<T>();
+                    std::nth_element(selected_items, selected_items + index, selected_items + size, order);
+                    return {value{selected_items[index]}};
+                }
+                default: {
+                    auto const& item = expected_argument.value();
+                    auto const key = std::is_floating_point_v<T> ? T(item.floating_point) : T(item.integer);
+                    return {value{platform::integer(std::lower_bound(items, items + size, key, order) - items)}};
+                }
             }
-            return {arguments};
         }
 
 
@@ -0,0 +1,114 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+
+#include <mandalang/code_fragment.hpp>
+#include <mandalang/ir.hpp>
+
+
+namespace mandalang {
+
+
+    // expressions compiled against globals of a module, by source text; least recently used
+    // ones are evicted over capacity, and one compiled against another version of globals
+    // is dropped on lookup, as its names may be bound to other symbols or types
+    class expression_cache {
+    public:
+
+        struct statistics {
+            std::uint64_t hits;
+            std::uint64_t misses;
+            std::uint64_t invalidations;
+            std::uint64_t evictions;
+        }; // statistics
+
+    private:
+
+        struct entry {
+            std::unique_ptr<code_fragment> fragment;
+            ast_node* expression;
+            std::uint64_t version;
+        };
+
+        std::size_t capacity_;
+        // most recently used first, keys are views of sources kept by fragments
+        std::list<entry> entries_;
+        std::unordered_map<std::string_view, std::list<entry>::iterator> index_;
+        statistics statistics_{};
+
+    public:
+
+        explicit expression_cache(std::size_t capacity) noexcept: capacity_{capacity} { }
+        expression_cache(expression_cache const&) = delete;
+        expression_cache& operator = (expression_cache const&) = delete;
+
+        std::size_t capacity() const noexcept { return capacity_; }
+        std::size_t size() const noexcept { return entries_.size(); }
+        statistics const& stats() const noexcept { return statistics_; }
+
+
+        void capacity(std::size_t capacity) noexcept {
+            capacity_ = capacity;
+            evict();
+        }
+
+
+        ast_node* find(std::string_view source, std::uint64_t version) noexcept {
+            auto const found = index_.find(source);
+            if(found == index_.end()) {
+                ++statistics_.misses;
+                return nullptr;
+            }
+            auto const each_entry = found->second;
+            if(each_entry->version != version) {
+                index_.erase(found);
+                entries_.erase(each_entry);
+                ++statistics_.invalidations;
+                ++statistics_.misses;
+                return nullptr;
+            }
+            entries_.splice(entries_.begin(), entries_, each_entry);
+            ++statistics_.hits;
+            return each_entry->expression;
+        }
+
+
+        // the source of the fragment should not be cached yet
+        ast_node* insert(std::unique_ptr<code_fragment> fragment, ast_node* expression, std::uint64_t version) {
+            entries_.push_front(entry{std::move(fragment), expression, version});
+            try {
+                index_.emplace(std::string_view{entries_.front().fragment->source}, entries_.begin());
+            } catch(...) {
+                entries_.pop_front();
+                throw;
+            }
+            evict();
+            return expression;
+        }
+
+
+        void clear() noexcept {
+            index_.clear();
+            entries_.clear();
+        }
+
+    private:
+
+        void evict() noexcept {
+            while(entries_.size() > capacity_) {
+                index_.erase(std::string_view{entries_.back().fragment->source});
+                entries_.pop_back();
+                ++statistics_.evictions;
+            }
+        }
+
+    }; // expression_cache
+
+
+} // namespace mandalang
@@ -1,17 +1,27 @@
 #pragma once
 
 
+#include <atomic>
+#include <cstring>
+#include <new>
 #include <vector>
 
+#include <tl/expected.hpp>
+
 #include <configure.hpp>
+#include <mandalang/error_info.hpp>
+#include <mandalang/name_table.hpp>
+#include <mandalang/persistent_vector.hpp>
 #include <mandalang/type.hpp>
+#include <mandalang/vector_buffer.hpp>
 
 
 namespace mandalang {
 
     enum class ast_node_tag {
         floating_point, integer, name,
-        subexpression, resolved_name,
+        floating_point_vector, integer_vector, vector_literal, vector_item,
+        subexpression, resolved_name, local_slot, last_local_slot, environment_slot, global_slot,
         negate, add, subtract, multiply, divide,
         floating_point_negate, floating_point_add, floating_point_subtract, floating_point_multiply, floating_point_divide,
         integer_negate, integer_add, integer_subtract, integer_multiply, integer_divide,
@@ -22,14 +32,137 @@ namespace mandalang {
         integer_equals_to, integer_not_equals_to, integer_greater_than, integer_greater_or_equals,
         integer_less_than, integer_less_or_equals,
         boolean_equals_to, boolean_not_equals_to,
+        floating_point_vector_add, floating_point_vector_subtract, floating_point_vector_multiply,
+        floating_point_vector_divide, integer_vector_add, integer_vector_subtract, integer_vector_multiply,
+        integer_vector_divide,
+        floating_point_vector_equals_to, floating_point_vector_not_equals_to, floating_point_vector_greater_than,
+        floating_point_vector_greater_or_equals, floating_point_vector_less_than, floating_point_vector_less_or_equals,
+        integer_vector_equals_to, integer_vector_not_equals_to, integer_vector_greater_than,
+        integer_vector_greater_or_equals, integer_vector_less_than, integer_vector_less_or_equals,
+        vector_map, vector_filter, vector_reduce, vector_reduce_associative, vector_zip, vector_range, vector_take,
+        vector_sum, vector_mean, vector_dot, vector_norm,
+        vector_sort, vector_argsort, vector_partial_sort, vector_nth_element, vector_lower_bound,
+        vector_set, vector_append, vector_slice, vector_concat, vector_to_persistent, persistent_to_vector,
         function, typed_name, type_item, resolved_function,
         function_call,
         function_argument, resolved_function_call,
-        type_function, type_vector,
+        type_function, type_vector, type_persistent,
         conditional
     };
 
+
+    // fields a node of solved IR reads its operands from, other tags have no layout
+    enum class node_layout {
+        unsupported, constant, packed_vector, vector_literal, link, parameter_slot, global_slot,
+        unary, binary, function, call, conditional
+    };
+
+
+    inline node_layout layout_of(ast_node_tag tag) noexcept {
+        switch(tag) {
+            case ast_node_tag::floating_point:
+            case ast_node_tag::integer:
+                return node_layout::constant;
+            case ast_node_tag::floating_point_vector:
+            case ast_node_tag::integer_vector:
+                return node_layout::packed_vector;
+            case ast_node_tag::vector_literal:
+                return node_layout::vector_literal;
+            case ast_node_tag::vector_item:
+            case ast_node_tag::function_argument:
+                return node_layout::link;
+            case ast_node_tag::local_slot:
+            case ast_node_tag::last_local_slot:
+            case ast_node_tag::environment_slot:
+                return node_layout::parameter_slot;
+            case ast_node_tag::global_slot:
+                return node_layout::global_slot;
+            case ast_node_tag::subexpression:
+            case ast_node_tag::floating_point_negate:
+            case ast_node_tag::integer_negate:
+            case ast_node_tag::boolean_not:
+                return node_layout::unary;
+            case ast_node_tag::floating_point_add:
+            case ast_node_tag::floating_point_subtract:
+            case ast_node_tag::floating_point_multiply:
+            case ast_node_tag::floating_point_divide:
+            case ast_node_tag::integer_add:
+            case ast_node_tag::integer_subtract:
+            case ast_node_tag::integer_multiply:
+            case ast_node_tag::integer_divide:
+            case ast_node_tag::boolean_or:
+            case ast_node_tag::boolean_and:
+            case ast_node_tag::floating_point_equals_to:
+            case ast_node_tag::floating_point_not_equals_to:
+            case ast_node_tag::floating_point_greater_than:
+            case ast_node_tag::floating_point_greater_or_equals:
+            case ast_node_tag::floating_point_less_than:
+            case ast_node_tag::floating_point_less_or_equals:
+            case ast_node_tag::integer_equals_to:
+            case ast_node_tag::integer_not_equals_to:
+            case ast_node_tag::integer_greater_than:
+            case ast_node_tag::integer_greater_or_equals:
+            case ast_node_tag::integer_less_than:
+            case ast_node_tag::integer_less_or_equals:
+            case ast_node_tag::boolean_equals_to:
+            case ast_node_tag::boolean_not_equals_to:
+            case ast_node_tag::floating_point_vector_add:
+            case ast_node_tag::floating_point_vector_subtract:
+            case ast_node_tag::floating_point_vector_multiply:
+            case ast_node_tag::floating_point_vector_divide:
+            case ast_node_tag::integer_vector_add:
+            case ast_node_tag::integer_vector_subtract:
+            case ast_node_tag::integer_vector_multiply:
+            case ast_node_tag::integer_vector_divide:
+            case ast_node_tag::floating_point_vector_equals_to:
+            case ast_node_tag::floating_point_vector_not_equals_to:
+            case ast_node_tag::floating_point_vector_greater_than:
+            case ast_node_tag::floating_point_vector_greater_or_equals:
+            case ast_node_tag::floating_point_vector_less_than:
+            case ast_node_tag::floating_point_vector_less_or_equals:
+            case ast_node_tag::integer_vector_equals_to:
+            case ast_node_tag::integer_vector_not_equals_to:
+            case ast_node_tag::integer_vector_greater_than:
+            case ast_node_tag::integer_vector_greater_or_equals:
+            case ast_node_tag::integer_vector_less_than:
+            case ast_node_tag::integer_vector_less_or_equals:
+                return node_layout::binary;
+            case ast_node_tag::resolved_function:
+                return node_layout::function;
+            case ast_node_tag::resolved_function_call:
+            case ast_node_tag::vector_map:
+            case ast_node_tag::vector_filter:
+            case ast_node_tag::vector_reduce:
+            case ast_node_tag::vector_reduce_associative:
+            case ast_node_tag::vector_zip:
+            case ast_node_tag::vector_range:
+            case ast_node_tag::vector_take:
+            case ast_node_tag::vector_sum:
+            case ast_node_tag::vector_mean:
+            case ast_node_tag::vector_dot:
+            case ast_node_tag::vector_norm:
+            case ast_node_tag::vector_sort:
+            case ast_node_tag::vector_argsort:
+            case ast_node_tag::vector_partial_sort:
+            case ast_node_tag::vector_nth_element:
+            case ast_node_tag::vector_lower_bound:
+            case ast_node_tag::vector_set:
+            case ast_node_tag::vector_append:
+            case ast_node_tag::vector_slice:
+            case ast_node_tag::vector_concat:
+            case ast_node_tag::vector_to_persistent:
+            case ast_node_tag::persistent_to_vector:
+                return node_layout::call;
+            case ast_node_tag::conditional:
+                return node_layout::conditional;
+            default:
+                return node_layout::unsupported;
+        }
+    }
+
+
     struct symbol;
+    struct value;
     class scope;
 
     struct ast_node {
@@ -38,7 +171,7 @@ namespace mandalang {
         union {
             double floating_point;
             platform::integer integer;
-            std::string_view name;
+            identifier name;
             ast_node *unary{nullptr};
             struct binary {
                 ast_node *left{nullptr};
@@ -50,6 +183,11 @@ namespace mandalang {
                 ast_node* result;
                 ast_node* body;
                 scope* scope{nullptr};
+                unsigned level{0};
+                // reads of values captured from enclosing functions linked by function_argument
+                // nodes, evaluated when the function is made; the function reads them after
+                // its arguments
+                ast_node* captures{nullptr};
             } function;
             struct prototype {
                 unsigned arity;
@@ -63,7 +201,7 @@ namespace mandalang {
             } call;
             struct typed_name {
                 ast_node* type;
-                std::string_view name;
+                identifier name;
                 ast_node* next;
             } typed_name;
             struct type_item {
@@ -75,11 +213,29 @@ namespace mandalang {
                 ast_node* then_branch;
                 ast_node* else_branch;
             } conditional;
+            vector_buffer* vector;
+            struct vector_literal {
+                unsigned size;
+                ast_node* items;
+            } vector_literal;
             symbol const* resolved_name;
+            struct slot {
+                symbol const* source;
+                value const* global;
+                unsigned index;
+                unsigned level;
+            } slot;
         };
         type type;
 
-        ast_node() noexcept { }
+        ast_node() noexcept: tag{ast_node_tag::floating_point} { }
+        ast_node(ast_node const&) = delete;
+        ast_node& operator = (ast_node const&) = delete;
+
+        ~ast_node() {
+            if(tag == ast_node_tag::floating_point_vector || tag == ast_node_tag::integer_vector)
+                vector_buffer::release(vector);
+        }
 
         ast_node(ast_node_tag tag, unsigned line_no) noexcept:
             tag{tag}, line_no{line_no} { }
@@ -93,10 +249,19 @@ namespace mandalang {
         ast_node(ast_node_tag tag, ast_node* unary, unsigned line_no) noexcept:
             tag{tag}, line_no{line_no}, unary{unary} { }
 
+        // packed constant of a literal-only vector, the node holds one reference to the buffer
+        ast_node(ast_node_tag tag, vector_buffer* vector, unsigned line_no) noexcept:
+            tag{tag}, line_no{line_no}, vector{vector} {
+            vector_buffer::retain(vector);
+        }
+
+        ast_node(unsigned size, ast_node* items, unsigned line_no) noexcept:
+            tag{ast_node_tag::vector_literal}, line_no{line_no}, vector_literal{size, items} { }
+
         ast_node(ast_node_tag tag, ast_node* left, ast_node* right, unsigned line_no) noexcept:
             tag{tag}, line_no{line_no}, binary{left, right} { }
 
-        ast_node(std::string_view name, unsigned line_no) noexcept:
+        ast_node(identifier name, unsigned line_no) noexcept:
             tag{ast_node_tag::name}, line_no{line_no}, name{name} { }
 
         ast_node(unsigned arity, ast_node* parameters, ast_node* result, ast_node* body, unsigned line_no) noexcept:
@@ -108,7 +273,7 @@ namespace mandalang {
         ast_node(ast_node* callee, unsigned arguments_count, ast_node* arguments, unsigned line_no) noexcept:
             tag{ast_node_tag::function_call}, line_no{line_no}, call{callee, arguments_count, arguments} { }
 
-        ast_node(ast_node* type, std::string_view name, unsigned line_no) noexcept:
+        ast_node(ast_node* type, identifier name, unsigned line_no) noexcept:
             tag{ast_node_tag::typed_name}, line_no{line_no}, typed_name{type, name, nullptr} { }
 
         ast_node(ast_node* type, unsigned line_no) noexcept:
@@ -120,10 +285,12 @@ namespace mandalang {
     }; // ast_node
 
 
-    struct value;
+    struct closure_environment;
+
     struct function_value {
         ast_node* native;
         value (*builtin)(std::vector<value> const&);
+        closure_environment* environment;
     };
 
 
@@ -134,10 +301,44 @@ namespace mandalang {
             platform::integer integer;
             bool boolean;
             function_value function;
+            vector_buffer* vector;
+            persistent_node* persistent;
         };
 
 
-        value() noexcept { }
+        value() noexcept: type{} { }
+
+        value(value const& other) noexcept: type{other.type} {
+            copy_payload(other);
+            retain();
+        }
+
+        value(value&& other) noexcept: type{other.type} {
+            copy_payload(other);
+            other.type = mandalang::type{};
+        }
+
+        value& operator = (value const& other) noexcept {
+            other.retain();
+            release();
+            type = other.type;
+            copy_payload(other);
+            return *this;
+        }
+
+        value& operator = (value&& other) noexcept {
+            if(this == &other)
+                return *this;
+            release();
+            type = other.type;
+            copy_payload(other);
+            other.type = mandalang::type{};
+            return *this;
+        }
+
+        ~value() {
+            release();
+        }
 
         explicit value(double floating_point) noexcept:
             type{type_tag::floating_point}, floating_point{floating_point} { }
@@ -149,16 +350,109 @@ namespace mandalang {
             type{type_tag::boolean}, boolean{boolean} { }
 
         value(struct type const& type, ast_node* native) noexcept:
-                type{type}, function{native, nullptr} { }
+                type{type}, function{native, nullptr, nullptr} { }
+
+        // adopts one reference to the environment
+        value(struct type const& type, ast_node* native, closure_environment* environment) noexcept:
+                type{type}, function{native, nullptr, environment} { }
 
         value(struct type const& type, value (*builtin)(std::vector<value> const&)) noexcept:
-            type{type}, function{nullptr, builtin} { }
+            type{type}, function{nullptr, builtin, nullptr} { }
+
+        // adopts one reference to the buffer
+        value(struct type const& type, vector_buffer* vector) noexcept:
+            type{type}, vector{vector} { }
+
+        // adopts one reference to the root, which is null for empty vectors
+        value(struct type const& type, persistent_node* persistent) noexcept:
+            type{type}, persistent{persistent} { }
+
+        explicit value(struct type const& type) noexcept: type{type}, function{} { }
+
+    private:
+
+        // all alternatives are trivially copyable, function is the widest one
+        void copy_payload(value const& other) noexcept {
+            std::memcpy(static_cast<void*>(&function), &other.function, sizeof(function));
+        }
 
-        explicit value(struct type const& type) noexcept: type{type} { }
+        void retain() const noexcept;
+        void release() noexcept;
 
     }; // value
 
 
+    // values a nested function reads from frames of enclosing functions, copied when the
+    // function is made, so the function may be called after those frames are gone
+    struct closure_environment {
+        std::atomic<std::size_t> references;
+        std::vector<value> captured;
+
+        static void retain(closure_environment* environment) noexcept {
+            environment->references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        static void release(closure_environment* environment) noexcept {
+            if(environment->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                delete environment;
+        }
+    }; // closure_environment
+
+
+    inline void value::retain() const noexcept {
+        if(type.is_vector())
+            vector_buffer::retain(vector);
+        else if(type.is_persistent())
+            persistent_node::retain(persistent);
+        else if(type.is_function() && function.environment != nullptr)
+            closure_environment::retain(function.environment);
+    }
+
+
+    inline void value::release() noexcept {
+        if(type.is_vector())
+            vector_buffer::release(vector);
+        else if(type.is_persistent())
+            persistent_node::release(persistent);
+        else if(type.is_function() && function.environment != nullptr)
+            closure_environment::release(function.environment);
+    }
+
+
+    // items of numerical vectors are packed values, comparisons of them make boolean vectors
+    inline std::size_t vector_item_size(type const& vector_type) noexcept {
+        switch(vector_type.composite->item.tag) {
+            case type_tag::floating_point:
+                return sizeof(double);
+            case type_tag::boolean:
+                return sizeof(bool);
+            default:
+                return sizeof(platform::integer);
+        }
+    }
+
+
+    // packed items separated by commas, preceded by one when items continue a sequence
+    template<typename S> void print_items(S& stream, type_tag item_tag, void const* items, std::size_t count,
+                                          bool continued) {
+        for(auto i = std::size_t(0); i != count; ++i) {
+            if(continued || i != 0)
+                stream << ", ";
+            switch(item_tag) {
+                case type_tag::floating_point:
+                    stream << static_cast<double const*>(items)[i];
+                    break;
+                case type_tag::boolean:
+                    stream << (static_cast<bool const*>(items)[i] ? std::string_view{"true"} : std::string_view{"false"});
+                    break;
+                default:
+                    stream << static_cast<platform::integer const*>(items)[i];
+                    break;
+            }
+        }
+    }
+
+
     template<typename S> S& operator << (S& stream, value const& value) {
         switch(value.type.tag) {
             case type_tag::floating_point:
@@ -171,6 +465,20 @@ namespace mandalang {
                 switch(value.type.composite->tag) {
                     case composite_type_tag::function:
                         return stream << value.type;
+                    case composite_type_tag::vector:
+                        stream << '[';
+                        print_items(stream, value.type.composite->item.tag, value.vector->items<char>(), value.vector->size,
+                                    false);
+                        return stream << ']';
+                    case composite_type_tag::persistent: {
+                        stream << '[';
+                        auto continued = false;
+                        persistent_vector::for_each_leaf(value.persistent, [&](char const* items, std::size_t count) {
+                            print_items(stream, value.type.composite->item.tag, items, count, continued);
+                            continued = true;
+                        });
+                        return stream << ']';
+                    }
                     default:
                         return stream << "unknown";
                 }
@@ -181,11 +489,27 @@ namespace mandalang {
 
 
     enum class symbol_tag {
-        value, expression, type_expression, type, fn_parameter
+        value, expression, type_expression, type, fn_parameter, deferred, intrinsic
+    };
+
+
+    // top-level definition of a lazily loaded module known only by its name and source span;
+    // compiling it redefines the symbol of the definition to the value or type
+    struct deferred_definition {
+        using compiler = tl::expected<void, error_info> (*)(deferred_definition&);
+
+        compiler compile;
+        void* module;
+        char const* begin;
+        char const* end;
+        unsigned line_no;
+        unsigned end_line_no;
+        std::size_t order;
     };
 
+
     struct symbol {
-        std::string_view name;
+        identifier name;
         symbol_tag tag;
         union {
             value value;
@@ -193,24 +517,94 @@ namespace mandalang {
             struct type type;
             struct function_parameter {
                 unsigned index;
-                unsigned depth;
+                unsigned level;
                 struct type type;
             } function_parameter;
+            deferred_definition* deferred;
+            ast_node_tag intrinsic;
         };
 
-        symbol() noexcept { }
+        symbol() noexcept: tag{symbol_tag::expression}, expression{nullptr} { }
+
+        symbol(symbol const& other) noexcept: name{other.name}, tag{other.tag} {
+            switch(tag) {
+                case symbol_tag::value:
+                    new(&value) mandalang::value(other.value);
+                    return;
+                case symbol_tag::expression:
+                case symbol_tag::type_expression:
+                    expression = other.expression;
+                    return;
+                case symbol_tag::type:
+                    type = other.type;
+                    return;
+                case symbol_tag::fn_parameter:
+                    function_parameter = other.function_parameter;
+                    return;
+                case symbol_tag::deferred:
+                    deferred = other.deferred;
+                    return;
+                case symbol_tag::intrinsic:
+                    intrinsic = other.intrinsic;
+                    return;
+            }
+        }
+
+        symbol& operator = (symbol const& other) noexcept {
+            if(this != &other) {
+                this->~symbol();
+                new(this) symbol(other);
+            }
+            return *this;
+        }
+
+        ~symbol() {
+            if(tag == symbol_tag::value)
+                value.~value();
+        }
 
-        symbol(std::string_view name, struct value const& value) noexcept:
+        symbol(identifier name, struct value const& value) noexcept:
                 name{name}, tag{symbol_tag::value}, value{value} { }
 
-        symbol(std::string_view name, symbol_tag tag, ast_node* expression) noexcept:
+        symbol(identifier name, symbol_tag tag, ast_node* expression) noexcept:
             name{name}, tag{tag}, expression{expression} { }
 
-        symbol(std::string_view name, struct type const& type) noexcept:
+        symbol(identifier name, struct type const& type) noexcept:
             name{name}, tag{symbol_tag::type}, type{type} { }
 
-        symbol(std::string_view name, unsigned index, unsigned depth) noexcept:
-                name{name}, tag{symbol_tag::fn_parameter}, function_parameter{index, depth} { }
+        symbol(identifier name, unsigned index, unsigned level) noexcept:
+                name{name}, tag{symbol_tag::fn_parameter}, function_parameter{index, level} { }
+
+        symbol(identifier name, deferred_definition* deferred) noexcept:
+                name{name}, tag{symbol_tag::deferred}, deferred{deferred} { }
+
+        // higher-order builtin, calls of it become nodes of the tag
+        symbol(identifier name, ast_node_tag intrinsic) noexcept:
+                name{name}, tag{symbol_tag::intrinsic}, intrinsic{intrinsic} { }
+
+
+        // entry reserved by scope::declare which is not defined yet
+        bool declared_only() const noexcept {
+            return tag == symbol_tag::expression && expression == nullptr;
+        }
+
+
+        void redefine(struct value const& other) noexcept {
+            if(tag == symbol_tag::value) {
+                value = other;
+                return;
+            }
+            tag = symbol_tag::value;
+            new(&value) mandalang::value(other);
+        }
+
+
+        void redefine(struct type const& other) noexcept {
+            if(tag == symbol_tag::value)
+                value.~value();
+            tag = symbol_tag::type;
+            type = other;
+        }
     }; // symbol
 
 
@@ -227,6 +621,10 @@ namespace mandalang {
                 return stream << symbol.type;
             case symbol_tag::fn_parameter:
                 return stream << symbol.function_parameter.type << " parameter";
+            case symbol_tag::deferred:
+                return stream << "<deferred>";
+            case symbol_tag::intrinsic:
+                return stream << "<builtin>";
             default:
                 return stream << "<unknown>";
         }
@@ -245,6 +643,26 @@ namespace mandalang {
 
         symbol_or_expression(struct symbol symbol) noexcept: tag{symbol_or_expression_tag::symbol}, symbol{symbol} { }
         symbol_or_expression(struct ast_node* expression) noexcept: tag{symbol_or_expression_tag::expression}, expression{expression} { }
+
+        symbol_or_expression(symbol_or_expression const& other) noexcept: tag{other.tag} {
+            if(tag == symbol_or_expression_tag::symbol)
+                new(&symbol) mandalang::symbol(other.symbol);
+            else
+                expression = other.expression;
+        }
+
+        symbol_or_expression& operator = (symbol_or_expression const& other) noexcept {
+            if(this != &other) {
+                this->~symbol_or_expression();
+                new(this) symbol_or_expression(other);
+            }
+            return *this;
+        }
+
+        ~symbol_or_expression() {
+            if(tag == symbol_or_expression_tag::symbol)
+                symbol.~symbol();
+        }
     }; // symbol_or_expression
 
 
@@ -261,7 +679,34 @@ namespace mandalang {
         };
 
         symbol_or_value(struct symbol const* symbol) noexcept: tag{symbol_or_value_tag::symbol}, symbol{symbol} { }
-        symbol_or_value(struct value value) noexcept: tag{symbol_or_value_tag::value}, value{value} { }
+        symbol_or_value(struct value value) noexcept: tag{symbol_or_value_tag::value}, value{std::move(value)} { }
+
+        symbol_or_value(symbol_or_value const& other) noexcept: tag{other.tag} {
+            if(tag == symbol_or_value_tag::value)
+                new(&value) mandalang::value(other.value);
+            else
+                symbol = other.symbol;
+        }
+
+        symbol_or_value(symbol_or_value&& other) noexcept: tag{other.tag} {
+            if(tag == symbol_or_value_tag::value)
+                new(&value) mandalang::value(std::move(other.value));
+            else
+                symbol = other.symbol;
+        }
+
+        symbol_or_value& operator = (symbol_or_value const& other) noexcept {
+            if(this != &other) {
+                this->~symbol_or_value();
+                new(this) symbol_or_value(other);
+            }
+            return *this;
+        }
+
+        ~symbol_or_value() {
+            if(tag == symbol_or_value_tag::value)
+                value.~value();
+        }
     };
 
 
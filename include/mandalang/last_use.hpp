@@ -0,0 +1,77 @@
+#pragma once
+
+
+#include <cstdint>
+
+#include <mandalang/ir.hpp>
+#include <mandalang/type.hpp>
+
+
+namespace mandalang {
+
+
+    // marks reads of function parameters after which the parameter is never read again, so the
+    // evaluator moves the value out of the frame and a vector passed as a temporary stays uniquely
+    // owned; a nested function reads the parameters it captures when it is made, so the reads
+    // of its captures count at the nested function node
+    class last_use {
+        using parameters = std::uint32_t;
+        static_assert(composite_type::max_function_parameters <= 32);
+
+        static constexpr auto unknown = ~parameters(0);
+
+        unsigned level_;
+
+    public:
+
+        static void mark(ast_node* function) noexcept {
+            auto analysis = last_use{function->function.level};
+            analysis.live_before(function->function.body, 0);
+        }
+
+    private:
+
+        explicit last_use(unsigned level) noexcept: level_{level} { }
+
+
+        // walks operands backwards from the order the evaluator reads them in,
+        // live holds parameters which may be read after the node
+        parameters live_before(ast_node* node, parameters live) noexcept {
+            if(node == nullptr)
+                return live;
+            switch(layout_of(node->tag)) {
+                case node_layout::parameter_slot: {
+                    if(node->tag == ast_node_tag::environment_slot || node->slot.level != level_)
+                        return live;
+                    auto const parameter = parameters(1) << node->slot.index;
+                    if((live & parameter) == 0)
+                        node->tag = ast_node_tag::last_local_slot;
+                    return live | parameter;
+                }
+                case node_layout::vector_literal:
+                    return live_before(node->vector_literal.items, live);
+                case node_layout::unary:
+                    return live_before(node->unary, live);
+                case node_layout::link:
+                case node_layout::binary:
+                    return live_before(node->binary.left, live_before(node->binary.right, live));
+                case node_layout::function:
+                    return live_before(node->function.captures, live);
+                case node_layout::call:
+                    return live_before(node->call.callee, live_before(node->call.arguments, live));
+                case node_layout::conditional: {
+                    auto const branches = live_before(node->conditional.then_branch, live) |
+                                          live_before(node->conditional.else_branch, live);
+                    return live_before(node->conditional.condition, branches);
+                }
+                case node_layout::unsupported:
+                    return unknown;
+                default:
+                    return live;
+            }
+        }
+
+    }; // last_use
+
+
+} // namespace mandalang
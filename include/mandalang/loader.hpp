@@ -1,53 +1,76 @@
 #pragma once
 
 
-#include <cstdio>
 #include <memory>
-#include <optional>
 #include <string>
-#include <system_error>
+#include <string_view>
 
+#include <tl/expected.hpp>
+
+#include <mandalang/code_fragment.hpp>
 #include <mandalang/error_info.hpp>
 #include <mandalang/mod.hpp>
+#include <mandalang/module_image.hpp>
+#include <mandalang/name_table.hpp>
+#include <mandalang/scope.hpp>
+#include <mandalang/source_mapping.hpp>
+#include <mandalang/type_table.hpp>
 
 
 namespace mandalang {
 
     class loader {
-    public:
+        friend class parallel_loader;
 
-        std::unique_ptr<mod> load(std::string const& path, std::system_error& se) {
-            auto maybe_source = read(path, se);
-            if(!maybe_source)
-                return nullptr;
-            auto m = std::make_unique<mod>(std::move(*source));
+    public:
 
-            return m;
+        // module source is mapped and scanned in place, the mapping is kept by the module;
+        // with images enabled a module is restored from an up to date image of its source
+        // or compiled and imaged, failing to write an image does not fail loading; lazy
+        // loading indexes definitions to compile them on demand, such modules are not imaged
+        static tl::expected<std::unique_ptr<mod>, error_info> load(std::string const& path,
+                                                                   type_table& types,
+                                                                   name_table& names,
+                                                                   scope const& prelude,
+                                                                   bool images = false,
+                                                                   bool lazy = false) {
+            auto expected_mapping = source_mapping::open(path);
+            if(!expected_mapping)
+                return tl::make_unexpected(expected_mapping.error());
+            auto const source_size = (*expected_mapping)->size();
+            auto const source_hash = images ? module_image::hash((*expected_mapping)->data(), source_size) : 0;
+            if(images) {
+                auto expected_imaged = module_image::load(module_image::path_of(path), source_hash, source_size,
+                                                          types, names, prelude);
+                if(expected_imaged) {
+                    (*expected_imaged)->name(names.intern(module_name(path)).text);
+                    return expected_imaged;
+                }
+            }
+            auto m = std::make_unique<mod>(types, names, &prelude);
+            m->name(names.intern(module_name(path)).text);
+            auto fragment = std::make_unique<code_fragment>();
+            fragment->mapping = std::move(*expected_mapping);
+            if(lazy && m->index_definitions(fragment))
+                return {std::move(m)};
+            auto const evaluated = m->evaluate_definitions(std::move(fragment));
+            if(!evaluated)
+                return tl::make_unexpected(evaluated.error());
+            if(images)
+                module_image::save(*m, source_hash, source_size, module_image::path_of(path));
+            return {std::move(m)};
         }
 
     private:
 
-
-        std::optional<std::string> read(std::string const& path, std::system_error& se) noexcept {
-            using namespace std;
-            unique_ptr<FILE, int (*)(FILE *)>
-                    file{fopen(path.data(), "rb"), fclose};
-            if (!file)
-                return failed(nullopt, se, static_cast<std::errc>(errno));
-            fseek(file.get(), 0, SEEK_END);
-            auto const file_size = std::size_t(ftell(file.get()));
-            if (file_size == std::size_t(-1L))
-                return failed(nullopt, se, static_cast<std::errc>(errno));
-            fseek(file.get(), 0, SEEK_SET);
-            try {
-                string source(file_size, '\0');
-                auto const bytes_read = fread(source.data(), 1, file_size, file.get());
-                if (bytes_read != file_size)
-                    failed(nullopt, se, static_cast<std::errc>(errno));
-                return std::move(source);
-            } catch (std::bad_alloc const& ba) {
-                return failed(nullopt, se, error::not_enough_memory);
-            }
+        static std::string_view module_name(std::string_view path) noexcept {
+            auto const separator = path.find_last_of("/\\");
+            if(separator != std::string_view::npos)
+                path.remove_prefix(separator + 1);
+            auto const extension = path.rfind('.');
+            if(extension != std::string_view::npos && extension != 0)
+                path.remove_suffix(path.size() - extension);
+            return path;
         }
 
     }; // loader
@@ -1,108 +1,382 @@
 #pragma once
 
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <list>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include <nonstd/memory_pool.hpp>
 #include <tl/expected.hpp>
 
 #include <mandalang/code_fragment.hpp>
+#include <mandalang/dependency_graph.hpp>
 #include <mandalang/error_info.hpp>
 #include <mandalang/evaluator.hpp>
 #include <mandalang/ir.hpp>
+#include <mandalang/name_table.hpp>
 #include <mandalang/parser.hpp>
 #include <mandalang/resolver.hpp>
+#include <mandalang/scanner.hpp>
 #include <mandalang/scope.hpp>
+#include <mandalang/token_buffer.hpp>
 #include <mandalang/type_solver.hpp>
+#include <mandalang/type_table.hpp>
 
 
 namespace mandalang {
 
 
+    enum class front_end_mode {
+        separate_passes, single_pass
+    }; // front_end_mode
+
+
     class mod {
+        friend class engine;
+        friend class module_image;
+        friend class parallel_loader;
+
         std::string_view name_;
+        type_table* types_;
+        name_table* names_;
+        front_end_mode front_end_{front_end_mode::single_pass};
         std::list<std::unique_ptr<code_fragment>> fragments_;
         nonstd::memory_pool<symbol> common_symbols_;
         scope globals_;
         scope publics_;
+        std::vector<deferred_definition> deferred_;
+        std::vector<symbol> deferred_symbols_;
+        code_fragment* deferred_source_{nullptr};
+        std::size_t visible_{std::size_t(-1)};
+        dependency_graph dependencies_;
+        // definitions of a module loaded in parallel are made on several threads
+        std::atomic<std::uint64_t> version_{0};
 
     public:
-        mod() noexcept = default;
+        // globals see names of the outer scope, usually the prelude, without copying them
+        mod(type_table& types, name_table& names, scope const* outer = nullptr) noexcept:
+            types_{&types}, names_{&names}, globals_{outer} { }
         mod(mod const&) noexcept = default;
         mod& operator = (mod const&) noexcept = default;
 
         std::string_view const& name() const noexcept { return name_; }
+        void name(std::string_view name) noexcept { name_ = name; }
+        scope const& globals() const noexcept { return globals_; }
         scope const& publics() const noexcept { return publics_; }
+        front_end_mode front_end() const noexcept { return front_end_; }
+        void front_end(front_end_mode mode) noexcept { front_end_ = mode; }
+        // changes when a global name is bound to another symbol or changes its type
+        std::uint64_t version() const noexcept { return version_.load(std::memory_order_relaxed); }
 
-        tl::expected<void, error_info> import(scope const& other) noexcept {
+        tl::expected<void, error_info> import(scope const& other) {
+            ++version_;
             return globals_.import(other);
         }
 
 
-        symbol const* redefine(std::string_view name, value const& value) {
-            return globals_.redefine(name, value, common_symbols_);
+        // definitions reading the name are evaluated again with the new value, unless it
+        // changes the type they were solved with
+        tl::expected<symbol const*, error_info> redefine(std::string_view name, value const& value) {
+            auto const id = names_->intern(name);
+            auto const* existing = globals_.find(id.id);
+            if(changes_type(existing, value) && dependencies_.has_dependents(existing))
+                return failed(error::redefinition_changes_type, name);
+            track_version(id, value);
+            auto const* redefined = globals_.redefine(id, value, common_symbols_);
+            dependencies_.forget(redefined);
+            auto changed = std::vector<symbol const*>{redefined};
+            auto const recomputed = dependencies_.recompute(changed);
+            if(!recomputed)
+                return tl::make_unexpected(recomputed.error());
+            return {redefined};
         }
 
 
         tl::expected<value, error_info> evaluate_expression(std::string source) {
             auto fragment = std::make_unique<code_fragment>();
             fragment->source = std::move(source);
-            parser p{fragment->source.data(), fragment->ast};
+            auto const expected_expression = compile_expression(*fragment);
+            if(!expected_expression)
+                return tl::make_unexpected(expected_expression.error());
+            return evaluate_solved_expression(*expected_expression);
+        }
+
+
+        // parses, resolves and solves types of an expression in the fragment source, the result
+        // can be evaluated again while the fragment is kept and globals keep their version
+        tl::expected<ast_node*, error_info> compile_expression(code_fragment& fragment) {
+            if(front_end_ == front_end_mode::single_pass) {
+                resolver resolver{fragment.ast, fragment.scopes, fragment.symbols};
+                type_solver type_solver{*types_, fragment.symbols};
+                parser p{fragment.text(), *names_, fragment.ast, resolver, type_solver, globals_};
+                auto const expected_expression = p.parse_expression();
+                if(expected_expression)
+                    return expected_expression;
+                // errors are reported by separate passes to keep diagnostics independent of front end mode
+            }
+            parser p{fragment.text(), *names_, fragment.ast};
             auto const expected_expression = p.parse_expression();
             if(!expected_expression)
                 return tl::make_unexpected(expected_expression.error());
-            return evaluate_expression(*fragment, *expected_expression);
+            auto const solved = solve_expression(fragment, *expected_expression);
+            if(!solved)
+                return tl::make_unexpected(solved.error());
+            return expected_expression;
         }
 
 
         tl::expected<symbol_or_value, error_info> evaluate_definition_or_expression(std::string source) {
             auto fragment = std::make_unique<code_fragment>();
             fragment->source = std::move(source);
-            parser p{fragment->source.data(), fragment->ast};
+            if(front_end_ == front_end_mode::single_pass) {
+                resolver resolver{fragment->ast, fragment->scopes, fragment->symbols};
+                type_solver type_solver{*types_, fragment->symbols};
+                auto reads = std::vector<symbol const*>{};
+                resolver.record_reads(&reads);
+                parser p{fragment->text(), *names_, fragment->ast, resolver, type_solver, globals_};
+                auto const expected_symbol_or_expression = p.parse_definition_or_expression();
+                if(expected_symbol_or_expression)
+                    return evaluate_symbol_or_expression(std::move(fragment), *expected_symbol_or_expression, true,
+                                                         std::move(reads));
+                // errors are reported by separate passes to keep diagnostics independent of front end mode
+            }
+            parser p{fragment->text(), *names_, fragment->ast};
             auto const expected_symbol_or_expression = p.parse_definition_or_expression();
             if(!expected_symbol_or_expression)
                 return tl::make_unexpected(expected_symbol_or_expression.error());
-            if(expected_symbol_or_expression->tag == symbol_or_expression_tag::expression) {
-                auto expected_value = evaluate_expression(*fragment, expected_symbol_or_expression->expression);
+            return evaluate_symbol_or_expression(std::move(fragment), *expected_symbol_or_expression, false, {});
+        }
+
+
+        // evaluates all definitions of a module source in order, each defined name becomes public
+        tl::expected<void, error_info> evaluate_definitions(std::unique_ptr<code_fragment> fragment) {
+            resolver resolver{fragment->ast, fragment->scopes, fragment->symbols};
+            type_solver type_solver{*types_, fragment->symbols};
+            auto solved = front_end_ == front_end_mode::single_pass;
+            auto reads = std::vector<symbol const*>{};
+            resolver.record_reads(&reads);
+            auto p = solved
+                    ? parser{fragment->text(), *names_, fragment->ast, resolver, type_solver, globals_}
+                    : parser{fragment->text(), *names_, fragment->ast};
+            while(!p.at_end()) {
+                auto const start = p.position();
+                reads.clear();
+                auto expected_symbol_or_expression = p.parse_definition_or_expression();
+                if(!expected_symbol_or_expression && solved) {
+                    // errors are reported by separate passes to keep diagnostics independent of front end mode
+                    p.position(start);
+                    p.detach();
+                    solved = false;
+                    reads.clear();
+                    expected_symbol_or_expression = p.parse_definition_or_expression();
+                }
+                if(!expected_symbol_or_expression)
+                    return tl::make_unexpected(expected_symbol_or_expression.error());
+                if(expected_symbol_or_expression->tag != symbol_or_expression_tag::symbol)
+                    return failed(error::expected_definition, expected_symbol_or_expression->expression->line_no);
+                auto const expected_symbol = define(*fragment, expected_symbol_or_expression->symbol, solved,
+                                                   solved ? std::move(reads) : std::vector<symbol const*>{});
+                if(!expected_symbol)
+                    return tl::make_unexpected(expected_symbol.error());
+                if(publics_.find_local((*expected_symbol)->name.id) == nullptr)
+                    publics_.define(*expected_symbol);
+            }
+            fragments_.push_front(std::move(fragment));
+            return {};
+        }
+
+
+        // indexes definitions of a module source by name and source span without parsing them,
+        // each is compiled on the first reference to its name and sees only names defined
+        // before it, as if the source was evaluated in order; a source which redefines names
+        // or has anything but definitions is not indexed and is left to evaluate_definitions
+        bool index_definitions(std::unique_ptr<code_fragment>& fragment) {
+            struct indexed {
+                identifier name;
+                char const* begin;
+                char const* end;
+                unsigned line_no;
+                unsigned end_line_no;
+            };
+
+            auto definitions = std::vector<indexed>{};
+            auto ids = std::vector<name_id>{};
+            scanner s{fragment->text(), *names_};
+            auto token = s.skim();
+            while(token.tag != token_tag::stop) {
+                if(token.tag != token_tag::keyword_let && token.tag != token_tag::keyword_type)
+                    return false;
+                auto const definition = token;
+                auto const name_token = s.skim();
+                if(name_token.tag != token_tag::name)
+                    return false;
+                auto const name = names_->intern(std::string_view{name_token.begin,
+                                                                  std::size_t(s.position() - name_token.begin)});
+                if(globals_.find(name.id) != nullptr)
+                    return false;
+                ids.push_back(name.id);
+                auto end = s.position();
+                for(token = s.skim(); token.tag != token_tag::stop && token.tag != token_tag::keyword_let
+                                      && token.tag != token_tag::keyword_type; token = s.skim())
+                    end = s.position();
+                definitions.push_back(indexed{name, definition.begin, end, definition.line_no, token.line_no});
+            }
+            std::sort(ids.begin(), ids.end());
+            if(std::adjacent_find(ids.begin(), ids.end()) != ids.end())
+                return false;
+            // symbols are kept in order of definitions, so later ones are a range to hide
+            globals_.reserve(definitions.size());
+            publics_.reserve(definitions.size());
+            deferred_.reserve(definitions.size());
+            deferred_symbols_.reserve(definitions.size());
+            for(auto const& each_definition: definitions) {
+                auto& deferred = deferred_.emplace_back(deferred_definition{&compile_deferred, this,
+                                                                            each_definition.begin, each_definition.end,
+                                                                            each_definition.line_no,
+                                                                            each_definition.end_line_no,
+                                                                            deferred_.size()});
+                auto& defined = deferred_symbols_.emplace_back(each_definition.name, &deferred);
+                globals_.define(&defined);
+                publics_.define(&defined);
+            }
+            deferred_source_ = fragment.get();
+            fragments_.push_front(std::move(fragment));
+            ++version_;
+            return true;
+        }
+
+
+        // compiles indexed definitions no one referred to yet, in order of the source
+        tl::expected<void, error_info> compile_deferred() {
+            for(auto i = std::size_t(0); i != deferred_.size(); ++i) {
+                if(deferred_symbols_[i].tag != symbol_tag::deferred)
+                    continue;
+                auto const compiled = compile_deferred(deferred_[i]);
+                if(!compiled)
+                    return compiled;
+            }
+            return {};
+        }
+
+    private:
+
+        static tl::expected<void, error_info> compile_deferred(deferred_definition& deferred) noexcept {
+            auto& m = *static_cast<mod*>(deferred.module);
+            auto const visible = m.visible_;
+            m.visible_ = deferred.order;
+            auto compiled = tl::expected<void, error_info>{};
+            try {
+                compiled = m.compile(deferred);
+            } catch(std::bad_alloc const&) {
+                compiled = failed(error::not_enough_memory);
+            }
+            m.visible_ = visible;
+            return compiled;
+        }
+
+
+        // definitions compiled on demand share one fragment, which also keeps the mapped source
+        tl::expected<void, error_info> compile(deferred_definition const& deferred) {
+            auto& fragment = *deferred_source_;
+            auto tokens = token_buffer::tokenize(deferred.begin, deferred.end, deferred.line_no,
+                                                 deferred.end_line_no, *names_);
+            parser p{std::move(tokens), fragment.ast};
+            auto const parsed = p.parse_definition_or_expression();
+            if(!parsed)
+                return tl::make_unexpected(parsed.error());
+            if(!p.at_end()) {
+                auto const rest = p.parse_definition_or_expression();
+                if(!rest)
+                    return tl::make_unexpected(rest.error());
+                return failed(error::expected_definition, rest->expression->line_no);
+            }
+            auto const defined = define(fragment, parsed->symbol, false);
+            if(!defined)
+                return tl::make_unexpected(defined.error());
+            return {};
+        }
+
+
+        // while a definition is compiled on demand, it and definitions after it are unknown names
+        void hide_later_definitions(resolver& resolver) const noexcept {
+            if(visible_ < deferred_symbols_.size())
+                resolver.hide(deferred_symbols_.data() + visible_, deferred_symbols_.data() + deferred_symbols_.size());
+        }
+
+
+        tl::expected<symbol_or_value, error_info> evaluate_symbol_or_expression(std::unique_ptr<code_fragment> fragment,
+                                                                                symbol_or_expression const& parsed,
+                                                                                bool solved,
+                                                                                std::vector<symbol const*> reads) {
+            if(parsed.tag == symbol_or_expression_tag::expression) {
+                auto expected_value = solved
+                        ? evaluate_solved_expression(parsed.expression)
+                        : evaluate_expression(*fragment, parsed.expression);
                 if(!expected_value)
                     return tl::make_unexpected(expected_value.error());
                 return {std::move(*expected_value)};
             }
-            switch(expected_symbol_or_expression->symbol.tag) {
+            switch(parsed.symbol.tag) {
                 case symbol_tag::expression:
-                    return evaluate_value_definition(std::move(fragment), expected_symbol_or_expression->symbol);
+                    return evaluate_value_definition(std::move(fragment), parsed.symbol, solved, std::move(reads));
                 case symbol_tag::type_expression:
-                    return evaluate_type_definition(std::move(fragment), expected_symbol_or_expression->symbol);
+                    return evaluate_type_definition(std::move(fragment), parsed.symbol);
                 default:
-                    return failed(error::invalid_symbol_to_evaluate, expected_symbol_or_expression->symbol.name);
+                    return failed(error::invalid_symbol_to_evaluate, parsed.symbol.name.text);
             }
-       }
+        }
+
+
+        tl::expected<value, error_info> evaluate_solved_expression(ast_node* expression) {
+            evaluator evaluator;
+            return evaluator.evaluate(expression);
+        }
+
+
+        tl::expected<value, error_info> evaluate_solved_expression(ast_node* expression, vector_buffer* destination) {
+            evaluator evaluator;
+            return evaluator.evaluate(expression, destination);
+        }
 
-    private:
 
-        tl::expected<value, error_info> evaluate_expression(code_fragment& fragment, ast_node* expression) {
-            resolver resolver{fragment.scopes, fragment.symbols};
+        tl::expected<value, error_info> evaluate_expression(code_fragment& fragment, ast_node* expression,
+                                                            std::vector<symbol const*>* reads = nullptr) {
+            auto const solved = solve_expression(fragment, expression, reads);
+            if(!solved)
+                return tl::make_unexpected(solved.error());
+            return evaluate_solved_expression(expression);
+        }
+
+
+        // globals the expression reads are appended to reads, if any
+        tl::expected<void, error_info> solve_expression(code_fragment& fragment, ast_node* expression,
+                                                        std::vector<symbol const*>* reads = nullptr) {
+            resolver resolver{fragment.ast, fragment.scopes, fragment.symbols};
+            hide_later_definitions(resolver);
+            resolver.record_reads(reads);
             auto const resolved = resolver.resolve_expression(globals_, expression);
             if(!resolved)
                 return tl::make_unexpected(resolved.error());
-            type_solver type_solver{fragment.composite_types, fragment.symbols};
+            type_solver type_solver{*types_, fragment.symbols};
             auto const types_solved = type_solver.solve(expression);
             if(!types_solved)
                 return tl::make_unexpected(types_solved.error());
-            evaluator evaluator;
-            return evaluator.evaluate(expression);
+            return {};
         }
 
 
         tl::expected<type, error_info> evaluate_type(code_fragment& fragment, ast_node* expression) {
-            resolver resolver{fragment.scopes, fragment.symbols};
+            resolver resolver{fragment.ast, fragment.scopes, fragment.symbols};
+            hide_later_definitions(resolver);
             auto const resolved = resolver.resolve_expression(globals_, expression);
             if(!resolved)
                 return tl::make_unexpected(resolved.error());
-            type_solver type_solver{fragment.composite_types, fragment.symbols};
+            type_solver type_solver{*types_, fragment.symbols};
             auto solved = type_solver.solve(expression);
             if(!solved)
                 return tl::make_unexpected(solved.error());
@@ -111,24 +385,81 @@ namespace mandalang {
 
 
         tl::expected<symbol_or_value, error_info> evaluate_value_definition(std::unique_ptr<code_fragment> fragment,
-                                                                            symbol const& symbol) {
-            auto expected_value = evaluate_expression(*fragment, symbol.expression);
-            if(!expected_value)
-                return tl::make_unexpected(expected_value.error());
-            auto const redefined = globals_.redefine(symbol.name, *expected_value, common_symbols_);
+                                                                            symbol const& symbol, bool solved,
+                                                                            std::vector<mandalang::symbol const*> reads) {
+            auto const expected_symbol = define_value(*fragment, symbol, solved, std::move(reads));
+            if(!expected_symbol)
+                return tl::make_unexpected(expected_symbol.error());
             fragments_.push_front(std::move(fragment));
-            return {symbol_or_value{redefined}};
+            return {symbol_or_value{*expected_symbol}};
         }
 
 
         tl::expected<symbol_or_value, error_info> evaluate_type_definition(std::unique_ptr<code_fragment> fragment,
                                                                            symbol const& symbol) {
-            auto expected_type = evaluate_type(*fragment, symbol.expression);
+            auto const expected_symbol = define_type(*fragment, symbol);
+            if(!expected_symbol)
+                return tl::make_unexpected(expected_symbol.error());
+            fragments_.push_front(std::move(fragment));
+            return {symbol_or_value{*expected_symbol}};
+        }
+
+
+        // reads are globals a solved definition read while it was parsed
+        tl::expected<symbol*, error_info> define(code_fragment& fragment, symbol const& symbol, bool solved,
+                                                 std::vector<mandalang::symbol const*> reads = {}) {
+            switch(symbol.tag) {
+                case symbol_tag::expression:
+                    return define_value(fragment, symbol, solved, std::move(reads));
+                case symbol_tag::type_expression:
+                    return define_type(fragment, symbol);
+                default:
+                    return failed(error::invalid_symbol_to_evaluate, symbol.name.text);
+            }
+        }
+
+
+        tl::expected<symbol*, error_info> define_value(code_fragment& fragment, symbol const& symbol, bool solved,
+                                                       std::vector<mandalang::symbol const*> reads) {
+            auto expected_value = solved
+                    ? evaluate_solved_expression(symbol.expression)
+                    : evaluate_expression(fragment, symbol.expression, &reads);
+            if(!expected_value)
+                return tl::make_unexpected(expected_value.error());
+            // definitions reading the value keep reading the same symbol, so they would read a value of another type
+            auto const* existing = globals_.find_local(symbol.name.id);
+            if(changes_type(existing, *expected_value) && dependencies_.has_dependents(existing))
+                return failed(error::redefinition_changes_type, symbol.name.text);
+            track_version(symbol.name, *expected_value);
+            globals_.redefine(symbol.name, *expected_value, common_symbols_);
+            auto* defined = globals_.find_local(symbol.name.id);
+            dependencies_.define(defined, symbol.expression, std::move(reads));
+            return {defined};
+        }
+
+
+        // definitions reading a value were solved with its type
+        static bool changes_type(symbol const* existing, value const& value) noexcept {
+            return existing != nullptr && (existing->tag != symbol_tag::value || existing->value.type != value.type);
+        }
+
+
+        // a value of the same type keeps expressions compiled against globals valid,
+        // a new name may shadow an outer one
+        void track_version(identifier name, value const& value) noexcept {
+            auto const* existing = globals_.find_local(name.id);
+            if(existing == nullptr || changes_type(existing, value))
+                ++version_;
+        }
+
+
+        tl::expected<symbol*, error_info> define_type(code_fragment& fragment, symbol const& symbol) {
+            auto expected_type = evaluate_type(fragment, symbol.expression);
             if(!expected_type)
                 return tl::make_unexpected(expected_type.error());
-            auto const redefined = globals_.redefine(symbol.name, *expected_type, common_symbols_);
-            fragments_.push_front(std::move(fragment));
-            return {symbol_or_value{redefined}};
+            ++version_;
+            globals_.redefine(symbol.name, *expected_type, common_symbols_);
+            return {globals_.find_local(symbol.name.id)};
         }
 
     };
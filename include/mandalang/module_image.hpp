@@ -0,0 +1,948 @@
+#pragma once
+
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+#include <mandalang/code_fragment.hpp>
+#include <mandalang/error_info.hpp>
+#include <mandalang/ir.hpp>
+#include <mandalang/mod.hpp>
+#include <mandalang/name_table.hpp>
+#include <mandalang/persistent_vector.hpp>
+#include <mandalang/scope.hpp>
+#include <mandalang/source_mapping.hpp>
+#include <mandalang/type.hpp>
+#include <mandalang/type_table.hpp>
+#include <mandalang/vector_buffer.hpp>
+
+
+namespace mandalang {
+
+
+    // compiled module stored next to its source: names, interned composite types,
+    // symbols with their values, typed IR of functions and of definitions evaluated
+    // again when a global they read is redefined; records refer to each
+    // other by index, so an image is independent of addresses it was written from;
+    // an image is used only if the hash and size of the source and the format match
+    class module_image {
+
+        // bumped on any change of records below or of ast_node_tag order
+        static constexpr std::uint32_t format_version = 12;
+        static constexpr std::uint32_t byte_order = 0x01020304;
+        static constexpr char magic[8] = {'M', 'L', 'I', 'M', 'A', 'G', 'E', '\0'};
+        static constexpr auto no_index = std::uint32_t(-1);
+
+        struct section {
+            std::uint64_t offset;
+            std::uint64_t count;
+        };
+
+        struct header {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byte_order;
+            std::uint32_t integer_size;
+            std::uint32_t reserved;
+            std::uint64_t source_hash;
+            std::uint64_t source_size;
+            section names;
+            section composites;
+            section symbols;
+            section nodes;
+            section definitions;
+            section data;
+        };
+
+        struct name_record {
+            std::uint64_t offset;
+            std::uint64_t size;
+        };
+
+        struct type_record {
+            std::uint32_t tag;
+            std::uint32_t composite;
+        };
+
+        struct composite_record {
+            std::uint32_t tag;
+            std::uint32_t arity;
+            type_record result;
+            type_record parameters[composite_type::max_function_parameters];
+        };
+
+        enum class symbol_kind : std::uint32_t {
+            defined, imported, local
+        };
+
+        struct symbol_record {
+            std::uint32_t name;
+            symbol_kind kind;
+            std::uint32_t tag;
+            std::uint32_t size;
+            type_record type;
+            std::uint64_t payload;
+        };
+
+        // a value captured by a function, records of them follow the index of the function node
+        struct captured_record {
+            type_record type;
+            std::uint32_t size;
+            std::uint32_t reserved;
+            std::uint64_t payload;
+        };
+
+        struct node_record {
+            std::uint32_t tag;
+            std::uint32_t line_no;
+            type_record type;
+            std::uint32_t operands[4];
+            std::uint64_t payload;
+        };
+
+        // a definition of the dependency graph, indexes of the symbols it reads are in data
+        struct definition_record {
+            std::uint32_t symbol;
+            std::uint32_t expression;
+            std::uint32_t reads_count;
+            std::uint32_t reserved;
+            std::uint64_t reads;
+        };
+
+
+        class writer {
+            mod const& module_;
+            std::vector<symbol const*> const& defined_;
+            std::unordered_set<symbol const*> defined_set_;
+            std::vector<name_record> names_;
+            std::unordered_map<name_id, std::uint32_t> name_indices_;
+            std::vector<composite_record> composites_;
+            std::unordered_map<composite_type const*, std::uint32_t> composite_indices_;
+            std::vector<symbol_record> symbols_;
+            std::unordered_map<symbol const*, std::uint32_t> symbol_indices_;
+            std::vector<node_record> nodes_;
+            std::unordered_map<ast_node const*, std::uint32_t> node_indices_;
+            std::vector<definition_record> definitions_;
+            std::string data_;
+
+        public:
+
+            writer(mod const& module, std::vector<symbol const*> const& defined):
+                module_{module}, defined_{defined}, defined_set_(defined.begin(), defined.end()) { }
+
+
+            tl::expected<std::string, error_info> write(std::uint64_t source_hash, std::uint64_t source_size) {
+                for(auto const* each_symbol: defined_) {
+                    auto const added = add_symbol(*each_symbol, symbol_kind::defined);
+                    if(!added)
+                        return tl::make_unexpected(added.error());
+                }
+                auto const added = add_definitions();
+                if(!added)
+                    return tl::make_unexpected(added.error());
+                auto image = std::string(sizeof(header), '\0');
+                auto h = header{};
+                std::memcpy(h.magic, magic, sizeof(magic));
+                h.version = format_version;
+                h.byte_order = byte_order;
+                h.integer_size = sizeof(platform::integer);
+                h.source_hash = source_hash;
+                h.source_size = source_size;
+                h.names = append(image, names_);
+                h.composites = append(image, composites_);
+                h.symbols = append(image, symbols_);
+                h.nodes = append(image, nodes_);
+                h.definitions = append(image, definitions_);
+                h.data = append(image, data_);
+                std::memcpy(image.data(), &h, sizeof(h));
+                return {std::move(image)};
+            }
+
+        private:
+
+            template<typename T> static section append(std::string& image, T const& records) {
+                image.resize((image.size() + vector_buffer::alignment - 1) / vector_buffer::alignment
+                             * vector_buffer::alignment, '\0');
+                auto const offset = image.size();
+                auto const bytes = records.size() * sizeof(records[0]);
+                image.append(reinterpret_cast<char const*>(records.data()), bytes);
+                return section{offset, records.size()};
+            }
+
+
+            std::uint32_t add_name(identifier name) {
+                auto const found = name_indices_.find(name.id);
+                if(found != name_indices_.end())
+                    return found->second;
+                auto const index = std::uint32_t(names_.size());
+                names_.push_back(name_record{add_data(name.text.data(), name.text.size(), 1), name.text.size()});
+                name_indices_.emplace(name.id, index);
+                return index;
+            }
+
+
+            std::uint64_t add_data(void const* bytes, std::size_t size, std::size_t alignment) {
+                data_.resize((data_.size() + alignment - 1) / alignment * alignment, '\0');
+                auto const offset = data_.size();
+                data_.append(static_cast<char const*>(bytes), size);
+                return offset;
+            }
+
+
+            // components are added before the composite, so a reader builds types in one pass
+            type_record add_type(type const& t) {
+                if(t.tag != type_tag::composite)
+                    return type_record{std::uint32_t(t.tag), no_index};
+                auto const found = composite_indices_.find(t.composite);
+                if(found != composite_indices_.end())
+                    return type_record{std::uint32_t(t.tag), found->second};
+                auto record = composite_record{std::uint32_t(t.composite->tag), 0, {}, {}};
+                switch(t.composite->tag) {
+                    case composite_type_tag::function:
+                        record.arity = t.composite->function.arity;
+                        record.result = add_type(t.composite->function.result);
+                        for(auto i = 0u; i != record.arity; ++i)
+                            record.parameters[i] = add_type(t.composite->function.parameters[i]);
+                        break;
+                    case composite_type_tag::vector:
+                    case composite_type_tag::persistent:
+                        record.result = add_type(t.composite->item);
+                        break;
+                }
+                auto const index = std::uint32_t(composites_.size());
+                composites_.push_back(record);
+                composite_indices_.emplace(t.composite, index);
+                return type_record{std::uint32_t(t.tag), index};
+            }
+
+
+            // index is taken before the value is added, as a function value may refer back to its symbol
+            tl::expected<std::uint32_t, error_info> add_symbol(symbol const& s, symbol_kind kind) {
+                auto const found = symbol_indices_.find(&s);
+                if(found != symbol_indices_.end())
+                    return found->second;
+                auto const index = std::uint32_t(symbols_.size());
+                symbol_indices_.emplace(&s, index);
+                symbols_.push_back(symbol_record{add_name(s.name), kind, std::uint32_t(s.tag), 0, {}, 0});
+                if(kind == symbol_kind::imported)
+                    return index;
+                auto record = symbols_[index];
+                switch(s.tag) {
+                    case symbol_tag::type:
+                        record.type = add_type(s.type);
+                        break;
+                    case symbol_tag::value: {
+                        record.type = add_type(s.value.type);
+                        auto const added = add_value(s.value, record.payload, record.size);
+                        if(!added)
+                            return tl::make_unexpected(added.error());
+                        break;
+                    }
+                    default:
+                        return failed(error::value_is_not_storable_in_image, s.name.text);
+                }
+                symbols_[index] = record;
+                return index;
+            }
+
+
+            tl::expected<void, error_info> add_value(value const& v, std::uint64_t& payload, std::uint32_t& size) {
+                switch(v.type.tag) {
+                    case type_tag::floating_point:
+                        std::memcpy(&payload, &v.floating_point, sizeof(v.floating_point));
+                        return {};
+                    case type_tag::integer:
+                        payload = std::uint64_t(v.integer);
+                        return {};
+                    case type_tag::boolean:
+                        payload = v.boolean ? 1 : 0;
+                        return {};
+                    // builtins such as map are names of the prelude, not values
+                    case type_tag::intrinsic:
+                        return failed(error::value_is_not_storable_in_image);
+                    case type_tag::composite:
+                        break;
+                }
+                if(v.type.is_vector()) {
+                    payload = add_data(v.vector->items<char>(), v.vector->size * item_size(v.type), vector_buffer::alignment);
+                    size = std::uint32_t(v.vector->size);
+                    return {};
+                }
+                // persistent vectors are stored as flat items and built again on reading
+                if(v.type.is_persistent()) {
+                    auto items = std::string(persistent_vector::size_of(v.persistent) * item_size(v.type), '\0');
+                    persistent_vector::copy_items(v.persistent, items.data(), item_size(v.type));
+                    payload = add_data(items.data(), items.size(), vector_buffer::alignment);
+                    size = std::uint32_t(persistent_vector::size_of(v.persistent));
+                    return {};
+                }
+                if(v.function.native == nullptr)
+                    return failed(error::value_is_not_storable_in_image);
+                auto const expected_index = add_node(v.function.native);
+                if(!expected_index)
+                    return tl::make_unexpected(expected_index.error());
+                if(v.function.environment == nullptr) {
+                    payload = *expected_index;
+                    return {};
+                }
+                // a function with captured values refers to data holding its node index and their records
+                auto const& captured = v.function.environment->captured;
+                auto closure = std::string(sizeof(std::uint64_t) + captured.size() * sizeof(captured_record), '\0');
+                auto const index = std::uint64_t(*expected_index);
+                std::memcpy(closure.data(), &index, sizeof(index));
+                for(auto i = std::size_t(0); i != captured.size(); ++i) {
+                    auto record = captured_record{add_type(captured[i].type), 0, 0, 0};
+                    auto const added = add_value(captured[i], record.payload, record.size);
+                    if(!added)
+                        return added;
+                    std::memcpy(closure.data() + sizeof(index) + i * sizeof(record), &record, sizeof(record));
+                }
+                payload = add_data(closure.data(), closure.size(), alignof(captured_record));
+                size = std::uint32_t(captured.size());
+                return {};
+            }
+
+
+            tl::expected<std::uint32_t, error_info> add_read(symbol const& source) {
+                auto const* global = module_.globals_.find(source.name.id);
+                auto const kind = defined_set_.count(&source) != 0
+                        ? symbol_kind::defined
+                        : global == &source
+                                ? symbol_kind::imported
+                                : symbol_kind::local;
+                return add_symbol(source, kind);
+            }
+
+
+            // definitions of other symbols than the defined ones are not restored with the image
+            tl::expected<void, error_info> add_definitions() {
+                auto result = tl::expected<void, error_info>{};
+                module_.dependencies_.for_each([&](symbol const* defined, ast_node const* expression,
+                                                   std::vector<symbol const*> const& reads) {
+                    if(!result || defined_set_.count(defined) == 0)
+                        return;
+                    auto record = definition_record{symbol_indices_.at(defined), 0, std::uint32_t(reads.size()), 0, 0};
+                    auto const expected_expression = add_node(expression);
+                    if(!expected_expression) {
+                        result = tl::make_unexpected(expected_expression.error());
+                        return;
+                    }
+                    record.expression = *expected_expression;
+                    auto indices = std::vector<std::uint32_t>{};
+                    indices.reserve(reads.size());
+                    for(auto const* each_read: reads) {
+                        auto const expected_read = add_read(*each_read);
+                        if(!expected_read) {
+                            result = tl::make_unexpected(expected_read.error());
+                            return;
+                        }
+                        indices.push_back(*expected_read);
+                    }
+                    record.reads = add_data(indices.data(), indices.size() * sizeof(std::uint32_t), alignof(std::uint32_t));
+                    definitions_.push_back(record);
+                });
+                return result;
+            }
+
+
+            tl::expected<std::uint32_t, error_info> add_node(ast_node const* node) {
+                if(node == nullptr)
+                    return no_index;
+                auto const found = node_indices_.find(node);
+                if(found != node_indices_.end())
+                    return found->second;
+                auto const index = std::uint32_t(nodes_.size());
+                node_indices_.emplace(node, index);
+                nodes_.push_back(node_record{std::uint32_t(node->tag), node->line_no, add_type(node->type),
+                                             {no_index, no_index, no_index, no_index}, 0});
+                auto record = nodes_[index];
+                auto const added = add_operands(node, record);
+                if(!added)
+                    return tl::make_unexpected(added.error());
+                nodes_[index] = record;
+                return index;
+            }
+
+
+            tl::expected<void, error_info> add_operands(ast_node const* node, node_record& record) {
+                ast_node const* operands[4] = {};
+                switch(layout_of(node->tag)) {
+                    case node_layout::constant:
+                        std::memcpy(&record.payload, &node->integer, sizeof(record.payload));
+                        return {};
+                    case node_layout::packed_vector:
+                        record.payload = add_data(node->vector->items<char>(), node->vector->size * item_size(node->type),
+                                                  vector_buffer::alignment);
+                        record.operands[0] = std::uint32_t(node->vector->size);
+                        return {};
+                    case node_layout::vector_literal: {
+                        record.operands[1] = node->vector_literal.size;
+                        auto const items = add_node(node->vector_literal.items);
+                        if(!items)
+                            return tl::make_unexpected(items.error());
+                        record.operands[0] = *items;
+                        return {};
+                    }
+                    case node_layout::parameter_slot:
+                        record.operands[0] = node->slot.index;
+                        record.operands[1] = node->slot.level;
+                        return {};
+                    case node_layout::global_slot: {
+                        auto const expected_symbol = add_read(*node->slot.source);
+                        if(!expected_symbol)
+                            return tl::make_unexpected(expected_symbol.error());
+                        record.operands[0] = *expected_symbol;
+                        return {};
+                    }
+                    case node_layout::function:
+                        record.operands[1] = node->function.level;
+                        record.operands[2] = node->function.arity;
+                        operands[0] = node->function.body;
+                        operands[3] = node->function.captures;
+                        break;
+                    case node_layout::call:
+                        record.operands[2] = node->call.arguments_count;
+                        operands[0] = node->call.callee;
+                        operands[1] = node->call.arguments;
+                        break;
+                    case node_layout::link:
+                    case node_layout::binary:
+                        operands[0] = node->binary.left;
+                        operands[1] = node->binary.right;
+                        break;
+                    case node_layout::unary:
+                        operands[0] = node->unary;
+                        break;
+                    case node_layout::conditional:
+                        operands[0] = node->conditional.condition;
+                        operands[1] = node->conditional.then_branch;
+                        operands[2] = node->conditional.else_branch;
+                        break;
+                    default:
+                        return failed(error::value_is_not_storable_in_image, node->line_no);
+                }
+                for(auto i = 0u; i != 4; ++i) {
+                    if(operands[i] == nullptr)
+                        continue;
+                    auto const expected_index = add_node(operands[i]);
+                    if(!expected_index)
+                        return tl::make_unexpected(expected_index.error());
+                    record.operands[i] = *expected_index;
+                }
+                return {};
+            }
+
+        }; // writer
+
+
+        class reader {
+            char const* image_;
+            std::size_t size_;
+            header header_;
+            type_table& types_;
+            name_table& names_;
+            mod& module_;
+            code_fragment& fragment_;
+            std::vector<identifier> names_read_;
+            std::vector<type> composites_read_;
+            std::vector<symbol*> symbols_read_;
+            std::vector<ast_node*> nodes_read_;
+            std::vector<symbol*> defined_;
+            std::shared_ptr<void const> keeper_;
+
+        public:
+
+            reader(char const* image, std::size_t size, header const& h, type_table& types, name_table& names,
+                   mod& module, code_fragment& fragment, std::shared_ptr<void const> keeper) noexcept:
+                image_{image}, size_{size}, header_{h}, types_{types}, names_{names},
+                module_{module}, fragment_{fragment}, keeper_{std::move(keeper)} { }
+
+
+            tl::expected<std::vector<symbol*>, error_info> read() {
+                if(!read_names() || !read_composites() || !read_symbols() || !read_nodes() || !read_values()
+                   || !read_definitions())
+                    return failed(error::invalid_module_image);
+                return {std::move(defined_)};
+            }
+
+        private:
+
+            template<typename T> T const* records(section const& s) const noexcept {
+                return reinterpret_cast<T const*>(image_ + s.offset);
+            }
+
+
+            char const* data(std::uint64_t offset, std::uint64_t size) const noexcept {
+                if(offset > header_.data.count || size > header_.data.count - offset)
+                    return nullptr;
+                return image_ + header_.data.offset + offset;
+            }
+
+
+            bool read_names() {
+                names_read_.reserve(header_.names.count);
+                auto const* name = records<name_record>(header_.names);
+                for(auto i = std::uint64_t(0); i != header_.names.count; ++i, ++name) {
+                    auto const* text = data(name->offset, name->size);
+                    if(text == nullptr)
+                        return false;
+                    names_read_.push_back(names_.intern(std::string_view{text, std::size_t(name->size)}));
+                }
+                return true;
+            }
+
+
+            tl::optional<type> type_of(type_record const& record) const noexcept {
+                switch(type_tag(record.tag)) {
+                    case type_tag::floating_point:
+                    case type_tag::integer:
+                    case type_tag::boolean:
+                        return type{type_tag(record.tag)};
+                    case type_tag::composite:
+                        if(record.composite >= composites_read_.size())
+                            return tl::nullopt;
+                        return composites_read_[record.composite];
+                    default:
+                        return tl::nullopt;
+                }
+            }
+
+
+            bool read_composites() {
+                composites_read_.reserve(header_.composites.count);
+                auto const* composite = records<composite_record>(header_.composites);
+                for(auto i = std::uint64_t(0); i != header_.composites.count; ++i, ++composite) {
+                    auto const result = type_of(composite->result);
+                    if(!result)
+                        return false;
+                    switch(composite_type_tag(composite->tag)) {
+                        case composite_type_tag::function: {
+                            if(composite->arity > composite_type::max_function_parameters)
+                                return false;
+                            type parameters[composite_type::max_function_parameters];
+                            for(auto j = 0u; j != composite->arity; ++j) {
+                                auto const parameter = type_of(composite->parameters[j]);
+                                if(!parameter)
+                                    return false;
+                                parameters[j] = *parameter;
+                            }
+                            composites_read_.push_back(types_.function(*result, composite->arity, parameters));
+                            break;
+                        }
+                        case composite_type_tag::vector:
+                            composites_read_.push_back(types_.vector(*result));
+                            break;
+                        case composite_type_tag::persistent:
+                            composites_read_.push_back(types_.persistent(*result));
+                            break;
+                        default:
+                            return false;
+                    }
+                }
+                return true;
+            }
+
+
+            // symbols are created before nodes, so global slots can point at their values
+            bool read_symbols() {
+                symbols_read_.reserve(header_.symbols.count);
+                auto const* record = records<symbol_record>(header_.symbols);
+                for(auto i = std::uint64_t(0); i != header_.symbols.count; ++i, ++record) {
+                    if(record->name >= names_read_.size())
+                        return false;
+                    auto const name = names_read_[record->name];
+                    switch(record->kind) {
+                        case symbol_kind::defined:
+                            symbols_read_.push_back(module_.globals_.declare(name, module_.common_symbols_));
+                            break;
+                        case symbol_kind::imported: {
+                            auto const* imported = module_.globals_.find(name.id);
+                            if(imported == nullptr)
+                                return false;
+                            symbols_read_.push_back(const_cast<symbol*>(imported));
+                            break;
+                        }
+                        case symbol_kind::local:
+                            symbols_read_.push_back(fragment_.symbols.create(name, symbol_tag::expression, nullptr));
+                            break;
+                        default:
+                            return false;
+                    }
+                }
+                return true;
+            }
+
+
+            bool read_nodes() {
+                nodes_read_.reserve(header_.nodes.count);
+                for(auto i = std::uint64_t(0); i != header_.nodes.count; ++i)
+                    nodes_read_.push_back(fragment_.ast.create());
+                auto const* record = records<node_record>(header_.nodes);
+                for(auto i = std::uint64_t(0); i != header_.nodes.count; ++i, ++record)
+                    if(!read_node(*record, *nodes_read_[i]))
+                        return false;
+                return true;
+            }
+
+
+            bool node_at(std::uint32_t index, ast_node*& node) const noexcept {
+                if(index == no_index) {
+                    node = nullptr;
+                    return true;
+                }
+                if(index >= nodes_read_.size())
+                    return false;
+                node = nodes_read_[index];
+                return true;
+            }
+
+
+            vector_buffer* read_items(char const* items, std::size_t count, std::size_t item_size) {
+                if(keeper_ && reinterpret_cast<std::uintptr_t>(items) % vector_buffer::alignment == 0)
+                    return vector_buffer::borrow(items, count, keeper_);
+                auto* buffer = vector_buffer::allocate(count, item_size);
+                std::memcpy(buffer->items<char>(), items, count * item_size);
+                buffer->size = count;
+                return buffer;
+            }
+
+
+            // tag is set last, so a node left half read is never released as a packed vector
+            bool read_node(node_record const& record, ast_node& node) {
+                auto const node_type = type_of(record.type);
+                if(!node_type)
+                    return false;
+                node.type = *node_type;
+                node.line_no = record.line_no;
+                auto const tag = ast_node_tag(record.tag);
+                switch(layout_of(tag)) {
+                    case node_layout::constant:
+                        std::memcpy(&node.integer, &record.payload, sizeof(record.payload));
+                        break;
+                    case node_layout::packed_vector: {
+                        if(!node.type.is_vector())
+                            return false;
+                        auto const bytes = std::size_t(record.operands[0]) * item_size(node.type);
+                        auto const* items = data(record.payload, bytes);
+                        if(items == nullptr)
+                            return false;
+                        node.vector = read_items(items, record.operands[0], item_size(node.type));
+                        break;
+                    }
+                    case node_layout::vector_literal:
+                        node.vector_literal.size = record.operands[1];
+                        if(!node_at(record.operands[0], node.vector_literal.items))
+                            return false;
+                        break;
+                    case node_layout::parameter_slot:
+                        node.slot = {nullptr, nullptr, record.operands[0], record.operands[1]};
+                        break;
+                    case node_layout::global_slot:
+                        if(record.operands[0] >= symbols_read_.size())
+                            return false;
+                        node.slot = {symbols_read_[record.operands[0]], &symbols_read_[record.operands[0]]->value, 0, 0};
+                        break;
+                    case node_layout::function:
+                        node.function = {record.operands[2], nullptr, nullptr, nullptr, nullptr, record.operands[1], nullptr};
+                        if(!node_at(record.operands[0], node.function.body) || !node_at(record.operands[3], node.function.captures))
+                            return false;
+                        break;
+                    case node_layout::call:
+                        node.call.arguments_count = record.operands[2];
+                        if(!node_at(record.operands[0], node.call.callee) || !node_at(record.operands[1], node.call.arguments))
+                            return false;
+                        break;
+                    case node_layout::link:
+                    case node_layout::binary:
+                        if(!node_at(record.operands[0], node.binary.left) || !node_at(record.operands[1], node.binary.right))
+                            return false;
+                        break;
+                    case node_layout::unary:
+                        if(!node_at(record.operands[0], node.unary))
+                            return false;
+                        break;
+                    case node_layout::conditional:
+                        if(!node_at(record.operands[0], node.conditional.condition)
+                           || !node_at(record.operands[1], node.conditional.then_branch)
+                           || !node_at(record.operands[2], node.conditional.else_branch))
+                            return false;
+                        break;
+                    default:
+                        return false;
+                }
+                node.tag = tag;
+                return true;
+            }
+
+
+            bool read_values() {
+                auto const* record = records<symbol_record>(header_.symbols);
+                for(auto i = std::uint64_t(0); i != header_.symbols.count; ++i, ++record) {
+                    if(record->kind == symbol_kind::imported)
+                        continue;
+                    auto* s = symbols_read_[i];
+                    auto const symbol_type = type_of(record->type);
+                    if(!symbol_type)
+                        return false;
+                    switch(symbol_tag(record->tag)) {
+                        case symbol_tag::type:
+                            s->redefine(*symbol_type);
+                            break;
+                        case symbol_tag::value: {
+                            auto expected_value = read_value(record->payload, record->size, *symbol_type);
+                            if(!expected_value)
+                                return false;
+                            s->redefine(*expected_value);
+                            break;
+                        }
+                        default:
+                            return false;
+                    }
+                    if(record->kind == symbol_kind::defined)
+                        defined_.push_back(s);
+                }
+                return true;
+            }
+
+
+            // definitions are defined again in the order they were written, which is their order
+            bool read_definitions() {
+                auto const* record = records<definition_record>(header_.definitions);
+                for(auto i = std::uint64_t(0); i != header_.definitions.count; ++i, ++record) {
+                    auto* expression = (ast_node*)nullptr;
+                    if(record->symbol >= symbols_read_.size() || record->expression == no_index
+                       || !node_at(record->expression, expression))
+                        return false;
+                    auto const* indices = data(record->reads, std::uint64_t(record->reads_count) * sizeof(std::uint32_t));
+                    if(indices == nullptr)
+                        return false;
+                    auto reads = std::vector<symbol const*>{};
+                    reads.reserve(record->reads_count);
+                    for(auto j = std::uint32_t(0); j != record->reads_count; ++j) {
+                        auto index = std::uint32_t(0);
+                        std::memcpy(&index, indices + j * sizeof(index), sizeof(index));
+                        if(index >= symbols_read_.size())
+                            return false;
+                        reads.push_back(symbols_read_[index]);
+                    }
+                    module_.dependencies_.define(symbols_read_[record->symbol], expression, std::move(reads));
+                }
+                return true;
+            }
+
+
+            tl::optional<value> read_value(std::uint64_t payload, std::uint32_t size, type const& value_type) {
+                switch(value_type.tag) {
+                    case type_tag::floating_point: {
+                        auto floating_point = 0.;
+                        std::memcpy(&floating_point, &payload, sizeof(floating_point));
+                        return value{floating_point};
+                    }
+                    case type_tag::integer:
+                        return value{platform::integer(payload)};
+                    case type_tag::boolean:
+                        return value{payload != 0};
+                    default:
+                        break;
+                }
+                if(value_type.is_vector()) {
+                    auto const bytes = std::size_t(size) * item_size(value_type);
+                    auto const* items = data(payload, bytes);
+                    if(items == nullptr)
+                        return tl::nullopt;
+                    return value{value_type, read_items(items, size, item_size(value_type))};
+                }
+                if(value_type.is_persistent()) {
+                    auto const bytes = std::size_t(size) * item_size(value_type);
+                    auto const* items = data(payload, bytes);
+                    if(items == nullptr)
+                        return tl::nullopt;
+                    return value{value_type, persistent_vector::build(items, size, item_size(value_type)).detach()};
+                }
+                auto const* closure = size == 0
+                        ? nullptr
+                        : data(payload, sizeof(std::uint64_t) + std::uint64_t(size) * sizeof(captured_record));
+                if(size != 0 && closure == nullptr)
+                    return tl::nullopt;
+                if(closure != nullptr)
+                    std::memcpy(&payload, closure, sizeof(payload));
+                auto* function = (ast_node*)nullptr;
+                if(payload >= nodes_read_.size() || !node_at(std::uint32_t(payload), function))
+                    return tl::nullopt;
+                if(function->tag != ast_node_tag::resolved_function)
+                    return tl::nullopt;
+                auto captures = std::uint32_t(0);
+                for(auto const* capture = function->function.captures; capture != nullptr; capture = capture->binary.right)
+                    ++captures;
+                // self of a function which captures values is stored without them
+                if(closure == nullptr)
+                    return value{value_type, function};
+                if(captures != size)
+                    return tl::nullopt;
+                auto* environment = new closure_environment{1, {}};
+                auto made = value{value_type, function, environment};
+                for(auto i = std::uint32_t(0); i != size; ++i) {
+                    auto record = captured_record{};
+                    std::memcpy(&record, closure + sizeof(std::uint64_t) + i * sizeof(record), sizeof(record));
+                    auto const captured_type = type_of(record.type);
+                    if(!captured_type)
+                        return tl::nullopt;
+                    auto captured = read_value(record.payload, record.size, *captured_type);
+                    if(!captured)
+                        return tl::nullopt;
+                    environment->captured.push_back(std::move(*captured));
+                }
+                return made;
+            }
+
+        }; // reader
+
+    public:
+
+        // FNV-1a of the source
+        static std::uint64_t hash(char const* data, std::size_t size) noexcept {
+            auto h = std::uint64_t(0xcbf29ce484222325ull);
+            for(auto i = std::size_t(0); i != size; ++i) {
+                h ^= std::uint8_t(data[i]);
+                h *= 0x100000001b3ull;
+            }
+            return h;
+        }
+
+
+        static std::string path_of(std::string const& source_path) {
+            return source_path + ".image";
+        }
+
+
+        // image of a module whose own symbols are the defined ones, other symbols
+        // referred to by its values are found by name when the image is read
+        static tl::expected<std::string, error_info> write(mod const& module,
+                                                           std::vector<symbol const*> const& defined,
+                                                           std::uint64_t source_hash,
+                                                           std::uint64_t source_size) {
+            return writer{module, defined}.write(source_hash, source_size);
+        }
+
+
+        // restores defined symbols of an image into globals of the module, which should
+        // have imported everything the image refers to; returns the defined symbols;
+        // with a keeper of the image memory vectors borrow their items from the image
+        static tl::expected<std::vector<symbol*>, error_info> read(char const* image,
+                                                                   std::size_t size,
+                                                                   std::uint64_t source_hash,
+                                                                   std::uint64_t source_size,
+                                                                   mod& module,
+                                                                   std::shared_ptr<void const> keeper = {}) {
+            auto h = header{};
+            if(size < sizeof(h))
+                return failed(error::invalid_module_image);
+            std::memcpy(&h, image, sizeof(h));
+            if(std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.byte_order != byte_order
+               || h.integer_size != sizeof(platform::integer))
+                return failed(error::invalid_module_image);
+            if(h.version != format_version || h.source_hash != source_hash || h.source_size != source_size)
+                return failed(error::stale_module_image);
+            if(!fits(h.names, sizeof(name_record), size)
+               || !fits(h.composites, sizeof(composite_record), size)
+               || !fits(h.symbols, sizeof(symbol_record), size)
+               || !fits(h.nodes, sizeof(node_record), size)
+               || !fits(h.definitions, sizeof(definition_record), size)
+               || !fits(h.data, 1, size))
+                return failed(error::invalid_module_image);
+            auto fragment = std::make_unique<code_fragment>();
+            auto expected_defined = reader{image, size, h, *module.types_, *module.names_, module, *fragment,
+                                           std::move(keeper)}.read();
+            if(!expected_defined)
+                return expected_defined;
+            module.fragments_.push_front(std::move(fragment));
+            return expected_defined;
+        }
+
+
+        // file is written to a temporary one first, so readers never see a partial file
+        static tl::expected<void, error_info> write_file(std::string const& path, std::string_view bytes) {
+            auto const temporary_path = path + ".tmp";
+            {
+                auto file = std::ofstream{temporary_path, std::ios::binary | std::ios::trunc};
+                if(!file.write(bytes.data(), std::streamsize(bytes.size())) || !file.flush())
+                    return failed(std::make_error_code(std::errc::io_error));
+            }
+            if(std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+                std::remove(temporary_path.c_str());
+                return failed(std::error_code{errno, std::generic_category()});
+            }
+            return {};
+        }
+
+
+        static tl::expected<void, error_info> save(mod const& module, std::uint64_t source_hash,
+                                                   std::uint64_t source_size, std::string const& path) {
+            auto defined = std::vector<symbol const*>{};
+            module.publics_.for_each([&](symbol const& each_symbol) { defined.push_back(&each_symbol); });
+            auto const expected_image = write(module, defined, source_hash, source_size);
+            if(!expected_image)
+                return tl::make_unexpected(expected_image.error());
+            return write_file(path, *expected_image);
+        }
+
+
+        // module chained to prelude with public definitions restored from the image file,
+        // the file stays mapped while vectors of the module borrow its items
+        static tl::expected<std::unique_ptr<mod>, error_info> load(std::string const& path,
+                                                                   std::uint64_t source_hash,
+                                                                   std::uint64_t source_size,
+                                                                   type_table& types,
+                                                                   name_table& names,
+                                                                   scope const& prelude) {
+            auto expected_mapping = source_mapping::open(path);
+            if(!expected_mapping)
+                return tl::make_unexpected(expected_mapping.error());
+            auto const mapping = std::shared_ptr<source_mapping const>{std::move(*expected_mapping)};
+            return load(mapping->data(), mapping->size(), source_hash, source_size, types, names, prelude, mapping);
+        }
+
+
+        static tl::expected<std::unique_ptr<mod>, error_info> load(char const* image,
+                                                                   std::size_t size,
+                                                                   std::uint64_t source_hash,
+                                                                   std::uint64_t source_size,
+                                                                   type_table& types,
+                                                                   name_table& names,
+                                                                   scope const& prelude,
+                                                                   std::shared_ptr<void const> keeper) {
+            auto m = std::make_unique<mod>(types, names, &prelude);
+            auto const expected_defined = read(image, size, source_hash, source_size, *m, std::move(keeper));
+            if(!expected_defined)
+                return tl::make_unexpected(expected_defined.error());
+            for(auto* each_symbol: *expected_defined)
+                if(m->publics_.find_local(each_symbol->name.id) == nullptr)
+                    m->publics_.define(each_symbol);
+            return {std::move(m)};
+        }
+
+    private:
+
+        static std::size_t item_size(type const& vector_type) noexcept {
+            return vector_item_size(vector_type);
+        }
+
+
+        static bool fits(section const& s, std::size_t record_size, std::size_t size) noexcept {
+            return s.offset % 8 == 0 && s.offset <= size && s.count <= (size - s.offset) / record_size;
+        }
+
+    }; // module_image
+
+
+} // namespace mandalang
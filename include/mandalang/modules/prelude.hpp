@@ -1,39 +1,90 @@
 #pragma once
 
 
-#include <memory>
-
-
-#include <nonstd/memory_pool.hpp>
-#include <tl/expected.hpp>
-
 #include <mandalang/ir.hpp>
-#include <mandalang/error_info.hpp>
+#include <mandalang/name_table.hpp>
 #include <mandalang/scope.hpp>
 
 
 namespace mandalang::modules {
 
 
+    // immutable symbols built once per process and shared by all engines; names are
+    // predefined in every name table and module globals chain to the exported scope;
+    // reduce folds items from the left, reduce_associative folds chunks of items in
+    // parallel and combines their results, so it is for associative functions only
     class prelude {
+        symbol integer_{integer_name, type{type_tag::integer}};
+        symbol double_{double_name, type{type_tag::floating_point}};
+        symbol boolean_{boolean_name, type{type_tag::boolean}};
+        symbol false_{false_name, value{false}};
+        symbol true_{true_name, value{true}};
+        symbol map_{map_name, ast_node_tag::vector_map};
+        symbol filter_{filter_name, ast_node_tag::vector_filter};
+        symbol reduce_{reduce_name, ast_node_tag::vector_reduce};
+        symbol reduce_associative_{reduce_associative_name, ast_node_tag::vector_reduce_associative};
+        symbol zip_{zip_name, ast_node_tag::vector_zip};
+        symbol range_{range_name, ast_node_tag::vector_range};
+        symbol take_{take_name, ast_node_tag::vector_take};
+        symbol sum_{sum_name, ast_node_tag::vector_sum};
+        symbol mean_{mean_name, ast_node_tag::vector_mean};
+        symbol dot_{dot_name, ast_node_tag::vector_dot};
+        symbol norm_{norm_name, ast_node_tag::vector_norm};
+        symbol sort_{sort_name, ast_node_tag::vector_sort};
+        symbol argsort_{argsort_name, ast_node_tag::vector_argsort};
+        symbol partial_sort_{partial_sort_name, ast_node_tag::vector_partial_sort};
+        symbol nth_element_{nth_element_name, ast_node_tag::vector_nth_element};
+        symbol lower_bound_{lower_bound_name, ast_node_tag::vector_lower_bound};
+        symbol set_{set_name, ast_node_tag::vector_set};
+        symbol append_{append_name, ast_node_tag::vector_append};
+        symbol slice_{slice_name, ast_node_tag::vector_slice};
+        symbol concat_{concat_name, ast_node_tag::vector_concat};
+        symbol to_persistent_{to_persistent_name, ast_node_tag::vector_to_persistent};
+        symbol to_vector_{to_vector_name, ast_node_tag::persistent_to_vector};
         scope exported_;
-        nonstd::memory_pool<symbol> symbols_;
+
+        prelude() {
+            exported_.define(&integer_);
+            exported_.define(&double_);
+            exported_.define(&boolean_);
+            exported_.define(&false_);
+            exported_.define(&true_);
+            exported_.define(&map_);
+            exported_.define(&filter_);
+            exported_.define(&reduce_);
+            exported_.define(&reduce_associative_);
+            exported_.define(&zip_);
+            exported_.define(&range_);
+            exported_.define(&take_);
+            exported_.define(&sum_);
+            exported_.define(&mean_);
+            exported_.define(&dot_);
+            exported_.define(&norm_);
+            exported_.define(&sort_);
+            exported_.define(&argsort_);
+            exported_.define(&partial_sort_);
+            exported_.define(&nth_element_);
+            exported_.define(&lower_bound_);
+            exported_.define(&set_);
+            exported_.define(&append_);
+            exported_.define(&slice_);
+            exported_.define(&concat_);
+            exported_.define(&to_persistent_);
+            exported_.define(&to_vector_);
+        }
+
     public:
 
-        prelude() noexcept = default;
+        prelude(prelude const&) = delete;
+        prelude& operator = (prelude const&) = delete;
 
-        scope const& exported() noexcept {
-            return exported_;
+        static prelude const& instance() {
+            static prelude const shared;
+            return shared;
         }
 
-        static tl::expected<std::unique_ptr<prelude>, error_info> initialize() {
-            auto m = std::make_unique<prelude>();
-            m->exported_.define(m->symbols_.create("integer", type{type_tag::integer}));
-            m->exported_.define(m->symbols_.create("double", type{type_tag::floating_point}));;
-            m->exported_.define(m->symbols_.create("boolean", type{type_tag::boolean}));
-            m->exported_.define(m->symbols_.create("false", value{false}));
-            m->exported_.define(m->symbols_.create("true", value{true}));
-            return {std::move(m)};
+        scope const& exported() const noexcept {
+            return exported_;
         }
     };
 
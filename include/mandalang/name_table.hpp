@@ -0,0 +1,153 @@
+#pragma once
+
+
+#include <bit>
+#include <cstdint>
+#include <forward_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+namespace mandalang {
+
+
+    using name_id = std::uint32_t;
+
+    struct identifier {
+        name_id id;
+        std::string_view text;
+    }; // identifier
+
+
+    inline constexpr auto no_name = name_id(-1);
+    inline constexpr auto self_name = identifier{0, "self"};
+    inline constexpr auto integer_name = identifier{1, "integer"};
+    inline constexpr auto double_name = identifier{2, "double"};
+    inline constexpr auto boolean_name = identifier{3, "boolean"};
+    inline constexpr auto false_name = identifier{4, "false"};
+    inline constexpr auto true_name = identifier{5, "true"};
+    inline constexpr auto map_name = identifier{6, "map"};
+    inline constexpr auto filter_name = identifier{7, "filter"};
+    inline constexpr auto reduce_name = identifier{8, "reduce"};
+    inline constexpr auto zip_name = identifier{9, "zip"};
+    inline constexpr auto range_name = identifier{10, "range"};
+    inline constexpr auto take_name = identifier{11, "take"};
+    inline constexpr auto sum_name = identifier{12, "sum"};
+    inline constexpr auto mean_name = identifier{13, "mean"};
+    inline constexpr auto dot_name = identifier{14, "dot"};
+    inline constexpr auto norm_name = identifier{15, "norm"};
+    inline constexpr auto sort_name = identifier{16, "sort"};
+    inline constexpr auto argsort_name = identifier{17, "argsort"};
+    inline constexpr auto partial_sort_name = identifier{18, "partial_sort"};
+    inline constexpr auto nth_element_name = identifier{19, "nth_element"};
+    inline constexpr auto lower_bound_name = identifier{20, "lower_bound"};
+    inline constexpr auto set_name = identifier{21, "set"};
+    inline constexpr auto append_name = identifier{22, "append"};
+    inline constexpr auto slice_name = identifier{23, "slice"};
+    inline constexpr auto concat_name = identifier{24, "concat"};
+    inline constexpr auto to_persistent_name = identifier{25, "to_persistent"};
+    inline constexpr auto to_vector_name = identifier{26, "to_vector"};
+    inline constexpr auto reduce_associative_name = identifier{27, "reduce_associative"};
+
+    // names with the same ids in every table, so the shared prelude needs no table
+    inline constexpr identifier predefined_names[] = {
+        self_name, integer_name, double_name, boolean_name, false_name, true_name,
+        map_name, filter_name, reduce_name, zip_name, range_name, take_name,
+        sum_name, mean_name, dot_name, norm_name,
+        sort_name, argsort_name, partial_sort_name, nth_element_name, lower_bound_name,
+        set_name, append_name, slice_name, concat_name, to_persistent_name, to_vector_name,
+        reduce_associative_name
+    };
+
+
+    template<typename S> S& operator << (S& stream, identifier const& name) {
+        return stream << name.text;
+    }
+
+
+    // names are interned from several loader threads; texts are kept in segments
+    // of doubling size that never move, so text lookup by a known id needs no lock;
+    // predefined names are seeded into the lookup but their texts live in predefined_names,
+    // so every intern is a single hash probe and segments are allocated by new names only
+    class name_table {
+        static constexpr auto predefined_count = name_id(std::size(predefined_names));
+        static constexpr auto first_segment_bits = 6u;
+        static constexpr auto first_segment_size = std::uint64_t(1) << first_segment_bits;
+        static constexpr auto segments_count = 32u - first_segment_bits + 1u;
+
+        struct location {
+            unsigned segment;
+            std::size_t offset;
+        };
+
+        mutable std::shared_mutex mutex_;
+        std::forward_list<std::string> storage_;
+        std::unordered_map<std::string_view, name_id> ids_;
+        std::unique_ptr<std::string_view[]> segments_[segments_count];
+        std::size_t size_{predefined_count};
+
+    public:
+
+        name_table() {
+            for(auto const& each_name: predefined_names)
+                ids_.try_emplace(each_name.text, each_name.id);
+        }
+
+        name_table(name_table const&) = delete;
+        name_table& operator = (name_table const&) = delete;
+
+
+        std::size_t size() const noexcept {
+            auto const lock = std::shared_lock{mutex_};
+            return size_;
+        }
+
+
+        std::string_view text(name_id id) const noexcept {
+            if(id < predefined_count)
+                return predefined_names[id].text;
+            auto const [segment, offset] = locate(id);
+            return segments_[segment][offset];
+        }
+
+
+        identifier intern(std::string_view text) {
+            {
+                auto const lock = std::shared_lock{mutex_};
+                auto const found = ids_.find(text);
+                if(found != ids_.end())
+                    return identifier{found->second, this->text(found->second)};
+            }
+            auto const lock = std::unique_lock{mutex_};
+            auto const found = ids_.find(text);
+            if(found != ids_.end())
+                return identifier{found->second, this->text(found->second)};
+            auto const id = name_id(size_);
+            auto const& stored = storage_.emplace_front(text);
+            auto const [segment, offset] = locate(id);
+            if(!segments_[segment])
+                segments_[segment] = std::make_unique<std::string_view[]>(std::size_t(first_segment_size << segment));
+            segments_[segment][offset] = stored;
+            ids_.try_emplace(std::string_view{stored}, id);
+            ++size_;
+            return identifier{id, stored};
+        }
+
+    private:
+
+        // segment k holds ids from predefined_count + first_segment_size * (2^k - 1)
+        static location locate(name_id id) noexcept {
+            auto const position = std::uint64_t(id - predefined_count) + first_segment_size;
+            auto const segment = unsigned(std::bit_width(position)) - first_segment_bits - 1u;
+            return {segment, std::size_t(position - (first_segment_size << segment))};
+        }
+
+    }; // name_table
+
+
+} // namespace mandalang
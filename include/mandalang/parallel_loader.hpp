@@ -0,0 +1,349 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <tl/expected.hpp>
+#include <tl/optional.hpp>
+
+#include <mandalang/code_fragment.hpp>
+#include <mandalang/error_info.hpp>
+#include <mandalang/ir.hpp>
+#include <mandalang/loader.hpp>
+#include <mandalang/mod.hpp>
+#include <mandalang/module_image.hpp>
+#include <mandalang/name_table.hpp>
+#include <mandalang/parser.hpp>
+#include <mandalang/scope.hpp>
+#include <mandalang/source_mapping.hpp>
+#include <mandalang/thread_pool.hpp>
+#include <mandalang/type_table.hpp>
+
+
+namespace mandalang {
+
+
+    // loads many module files at once: files are parsed concurrently, each file is split
+    // into top-level definitions and definitions are resolved, typed and evaluated on
+    // pool threads as soon as definitions they depend on are done; results and errors
+    // are the same as of loading the files one by one
+    class parallel_loader {
+
+        struct definition {
+            symbol parsed;
+            std::unique_ptr<code_fragment> fragment;
+            std::vector<std::size_t> dependents;
+            std::atomic<std::size_t> pending{0};
+            std::atomic<bool> blocked{false};
+            tl::optional<error_info> error;
+
+            explicit definition(symbol const& parsed): parsed{parsed} { }
+        };
+
+        struct module_load {
+            std::string const* path;
+            std::unique_ptr<mod> module;
+            std::unique_ptr<code_fragment> source;
+            std::deque<definition> definitions;
+            tl::optional<error_info> error;
+            std::uint64_t source_hash{0};
+            std::uint64_t source_size{0};
+            bool imaged{false};
+            bool indexed{false};
+        };
+
+        type_table& types_;
+        name_table& names_;
+        scope const& prelude_;
+        thread_pool& pool_;
+        bool images_;
+        bool lazy_;
+
+        parallel_loader(type_table& types, name_table& names, scope const& prelude, thread_pool& pool,
+                        bool images, bool lazy) noexcept:
+            types_{types}, names_{names}, prelude_{prelude}, pool_{pool}, images_{images}, lazy_{lazy} { }
+
+    public:
+
+        static tl::expected<std::vector<std::unique_ptr<mod>>, error_info> load(std::vector<std::string> const& paths,
+                                                                                type_table& types,
+                                                                                name_table& names,
+                                                                                scope const& prelude,
+                                                                                thread_pool& pool,
+                                                                                bool images = false,
+                                                                                bool lazy = false) {
+            auto loader = parallel_loader{types, names, prelude, pool, images, lazy};
+            auto loads = std::deque<module_load>(paths.size());
+            for(auto i = std::size_t(0); i != paths.size(); ++i) {
+                loads[i].path = &paths[i];
+                pool.submit([&loader, &each_load = loads[i]] { loader.parse(each_load); });
+            }
+            pool.wait();
+            auto modules = std::vector<std::unique_ptr<mod>>{};
+            modules.reserve(paths.size());
+            for(auto& each_load: loads) {
+                auto const finished = finish(each_load);
+                if(!finished)
+                    return tl::make_unexpected(finished.error());
+                if(images && !each_load.imaged && !each_load.indexed)
+                    module_image::save(*each_load.module, each_load.source_hash, each_load.source_size,
+                                       module_image::path_of(*each_load.path));
+                modules.push_back(std::move(each_load.module));
+            }
+            return {std::move(modules)};
+        }
+
+    private:
+
+        void parse(module_load& load) noexcept {
+            try {
+                auto expected_mapping = source_mapping::open(*load.path);
+                if(!expected_mapping) {
+                    load.error = expected_mapping.error();
+                    return;
+                }
+                load.source_size = (*expected_mapping)->size();
+                if(images_) {
+                    load.source_hash = module_image::hash((*expected_mapping)->data(), load.source_size);
+                    auto expected_imaged = module_image::load(module_image::path_of(*load.path), load.source_hash,
+                                                              load.source_size, types_, names_, prelude_);
+                    if(expected_imaged) {
+                        load.module = std::move(*expected_imaged);
+                        load.module->name(names_.intern(loader::module_name(*load.path)).text);
+                        load.imaged = true;
+                        return;
+                    }
+                }
+                load.module = std::make_unique<mod>(types_, names_, &prelude_);
+                load.module->name(names_.intern(loader::module_name(*load.path)).text);
+                load.source = std::make_unique<code_fragment>();
+                load.source->mapping = std::move(*expected_mapping);
+                if(lazy_ && load.module->index_definitions(load.source)) {
+                    load.indexed = true;
+                    return;
+                }
+                parser p{load.source->text(), names_, load.source->ast};
+                while(!p.at_end()) {
+                    auto const expected_symbol_or_expression = p.parse_definition_or_expression();
+                    if(!expected_symbol_or_expression) {
+                        load.error = expected_symbol_or_expression.error();
+                        break;
+                    }
+                    if(expected_symbol_or_expression->tag != symbol_or_expression_tag::symbol) {
+                        load.error = failed(error::expected_definition,
+                                            expected_symbol_or_expression->expression->line_no).value();
+                        break;
+                    }
+                    auto& each_definition = load.definitions.emplace_back(expected_symbol_or_expression->symbol);
+                    each_definition.fragment = std::make_unique<code_fragment>();
+                }
+                link(load);
+                for(auto& each_definition: load.definitions)
+                    if(each_definition.pending.load(std::memory_order_relaxed) == 0)
+                        schedule(load, each_definition);
+            } catch(std::bad_alloc const&) {
+                load.error = failed(error::not_enough_memory).value();
+                load.definitions.clear();
+            }
+        }
+
+
+        // a definition waits for the latest earlier definitions of names it refers to;
+        // a definition referring to a name defined only later is done before it, so it
+        // still sees that name as unknown; redefinition of a name waits for everything
+        // before it and everything after waits for it, as functions may read it when called
+        void link(module_load& load) {
+            auto& globals = load.module->globals_;
+            auto const count = load.definitions.size();
+            auto defined_later = std::unordered_map<name_id, std::size_t>{};
+            for(auto i = count; i-- != 0;)
+                defined_later[load.definitions[i].parsed.name.id] = i;
+            auto latest = std::unordered_map<name_id, std::size_t>{};
+            auto barrier = count;
+            auto since_barrier = std::vector<std::size_t>{};
+            auto references = std::vector<identifier>{};
+            auto bound = std::vector<name_id>{};
+            for(auto i = std::size_t(0); i != count; ++i) {
+                auto& each_definition = load.definitions[i];
+                auto const name = each_definition.parsed.name;
+                auto dependencies = std::vector<std::size_t>{};
+                if(barrier != count)
+                    dependencies.push_back(barrier);
+                auto const redefinition = latest.count(name.id) != 0 || globals.find(name.id) != nullptr;
+                if(redefinition) {
+                    dependencies.insert(dependencies.end(), since_barrier.begin(), since_barrier.end());
+                } else {
+                    references.clear();
+                    bound.clear();
+                    collect_references(each_definition.parsed.expression, bound, references);
+                    for(auto const& reference: references) {
+                        auto const found_latest = latest.find(reference.id);
+                        if(found_latest != latest.end()) {
+                            dependencies.push_back(found_latest->second);
+                            continue;
+                        }
+                        auto const found_later = defined_later.find(reference.id);
+                        if(found_later != defined_later.end() && found_later->second > i &&
+                           globals.find(reference.id) == nullptr)
+                            load.definitions[found_later->second].pending.fetch_add(1, std::memory_order_relaxed),
+                            each_definition.dependents.push_back(found_later->second);
+                    }
+                }
+                std::sort(dependencies.begin(), dependencies.end());
+                dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+                for(auto const dependency: dependencies)
+                    load.definitions[dependency].dependents.push_back(i);
+                each_definition.pending.fetch_add(dependencies.size(), std::memory_order_relaxed);
+                latest[name.id] = i;
+                if(redefinition) {
+                    barrier = i;
+                    since_barrier.clear();
+                } else {
+                    since_barrier.push_back(i);
+                }
+            }
+            // names are reserved up front, so defining them later never moves the globals table;
+            // names of the prelude are shadowed only by their redefinition, which runs alone
+            for(auto& each_definition: load.definitions)
+                if(globals.find(each_definition.parsed.name.id) == nullptr)
+                    globals.declare(each_definition.parsed.name, load.module->common_symbols_);
+        }
+
+
+        // names which are not parameters of enclosing functions
+        static void collect_references(ast_node const* node, std::vector<name_id>& bound,
+                                       std::vector<identifier>& references) {
+            if(node == nullptr)
+                return;
+            switch(node->tag) {
+                case ast_node_tag::name:
+                    if(std::find(bound.begin(), bound.end(), node->name.id) == bound.end())
+                        references.push_back(node->name);
+                    return;
+                case ast_node_tag::vector_literal:
+                    for(auto const* item = node->vector_literal.items; item != nullptr; item = item->binary.right)
+                        collect_references(item->binary.left, bound, references);
+                    return;
+                case ast_node_tag::subexpression:
+                case ast_node_tag::negate:
+                case ast_node_tag::boolean_not:
+                case ast_node_tag::type_vector:
+                case ast_node_tag::type_persistent:
+                    collect_references(node->unary, bound, references);
+                    return;
+                case ast_node_tag::multiply:
+                case ast_node_tag::divide:
+                case ast_node_tag::add:
+                case ast_node_tag::subtract:
+                case ast_node_tag::boolean_or:
+                case ast_node_tag::boolean_and:
+                case ast_node_tag::equals_to:
+                case ast_node_tag::not_equals_to:
+                case ast_node_tag::greater_than:
+                case ast_node_tag::greater_or_equals:
+                case ast_node_tag::less_than:
+                case ast_node_tag::less_or_equals:
+                    collect_references(node->binary.left, bound, references);
+                    collect_references(node->binary.right, bound, references);
+                    return;
+                case ast_node_tag::function: {
+                    collect_references(node->function.result, bound, references);
+                    auto const outer_bound = bound.size();
+                    for(auto const* parameter = node->function.parameters; parameter != nullptr;
+                        parameter = parameter->typed_name.next) {
+                        collect_references(parameter->typed_name.type, bound, references);
+                        bound.push_back(parameter->typed_name.name.id);
+                    }
+                    bound.push_back(self_name.id);
+                    collect_references(node->function.body, bound, references);
+                    bound.resize(outer_bound);
+                    return;
+                }
+                case ast_node_tag::function_call:
+                    collect_references(node->call.callee, bound, references);
+                    for(auto const* argument = node->call.arguments; argument != nullptr; argument = argument->binary.right)
+                        collect_references(argument->binary.left, bound, references);
+                    return;
+                case ast_node_tag::conditional:
+                    collect_references(node->conditional.condition, bound, references);
+                    collect_references(node->conditional.then_branch, bound, references);
+                    collect_references(node->conditional.else_branch, bound, references);
+                    return;
+                case ast_node_tag::type_function:
+                    collect_references(node->prototype.result, bound, references);
+                    for(auto const* parameter = node->prototype.parameters; parameter != nullptr;
+                        parameter = parameter->type_item.next)
+                        collect_references(parameter->type_item.type, bound, references);
+                    return;
+                default:
+                    return;
+            }
+        }
+
+
+        void schedule(module_load& load, definition& each_definition) {
+            pool_.submit([this, &load, &each_definition] { compile(load, each_definition); });
+        }
+
+
+        // definitions after a failed one are not compiled, as loading would have stopped there
+        void compile(module_load& load, definition& each_definition) noexcept {
+            auto failed_here = each_definition.blocked.load(std::memory_order_acquire);
+            if(!failed_here) {
+                try {
+                    auto const defined = load.module->define(*each_definition.fragment, each_definition.parsed, false);
+                    if(!defined) {
+                        each_definition.error = defined.error();
+                        failed_here = true;
+                    }
+                } catch(std::bad_alloc const&) {
+                    each_definition.error = failed(error::not_enough_memory).value();
+                    failed_here = true;
+                }
+            }
+            for(auto const dependent: each_definition.dependents) {
+                auto& next_definition = load.definitions[dependent];
+                if(failed_here)
+                    next_definition.blocked.store(true, std::memory_order_release);
+                if(next_definition.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    try {
+                        schedule(load, next_definition);
+                    } catch(std::bad_alloc const&) {
+                        next_definition.error = failed(error::not_enough_memory).value();
+                    }
+                }
+            }
+        }
+
+
+        // the first failed definition wins, a parsing error comes after all parsed definitions
+        static tl::expected<void, error_info> finish(module_load& load) {
+            for(auto const& each_definition: load.definitions)
+                if(each_definition.error)
+                    return tl::make_unexpected(*each_definition.error);
+            if(load.error)
+                return tl::make_unexpected(*load.error);
+            if(load.imaged || load.indexed)
+                return {};
+            auto& module = *load.module;
+            module.fragments_.push_front(std::move(load.source));
+            for(auto& each_definition: load.definitions) {
+                module.fragments_.push_front(std::move(each_definition.fragment));
+                auto const id = each_definition.parsed.name.id;
+                if(module.publics_.find_local(id) == nullptr)
+                    module.publics_.define(module.globals_.find_local(id));
+            }
+            return {};
+        }
+
+    }; // parallel_loader
+
+
+} // namespace mandalang
@@ -1,14 +1,18 @@
 #pragma once
 
 
+#include <utility>
+
 #include <nonstd/memory_pool.hpp>
 #include <tl/expected.hpp>
 #include <tl/optional.hpp>
 
 #include <mandalang/ir.hpp>
 #include <mandalang/error_info.hpp>
-#include <mandalang/scanner.hpp>
+#include <mandalang/resolver.hpp>
 #include <mandalang/scope.hpp>
+#include <mandalang/token_buffer.hpp>
+#include <mandalang/type_solver.hpp>
 
 
 
@@ -16,37 +20,59 @@ namespace mandalang {
 
 
     class parser {
-        scanner scanner_;
+        token_buffer tokens_;
+        token_buffer::size_type cursor_{0};
         nonstd::memory_pool<ast_node>& nodes_;
+        resolver* resolver_{nullptr};
+        type_solver* type_solver_{nullptr};
+        scope* scope_{nullptr};
 
     public:
 
-        parser(char const* source, nonstd::memory_pool<ast_node>& nodes) noexcept
-            : scanner_{source}, nodes_{nodes} { }
+        parser(char const* source, name_table& names, nonstd::memory_pool<ast_node>& nodes)
+            : tokens_{token_buffer::tokenize(source, names)}, nodes_{nodes} { }
+
+        parser(token_buffer tokens, nonstd::memory_pool<ast_node>& nodes)
+            : tokens_{std::move(tokens)}, nodes_{nodes} { }
+
+        // single pass parser resolves and types every expression node as soon as it is created
+        parser(char const* source, name_table& names, nonstd::memory_pool<ast_node>& nodes,
+               resolver& resolver, type_solver& type_solver, scope& scope)
+            : tokens_{token_buffer::tokenize(source, names)}, nodes_{nodes},
+              resolver_{&resolver}, type_solver_{&type_solver}, scope_{&scope} { }
 
-        parser(parser const&) noexcept = default;
-        parser& operator = (parser const&) noexcept = default;
+        parser(parser const&) = default;
+        parser& operator = (parser const&) = default;
+
+        bool at_end() const noexcept { return peek() == token_tag::stop; }
+        token_buffer::size_type position() const noexcept { return cursor_; }
+        void position(token_buffer::size_type cursor) noexcept { cursor_ = cursor; }
+
+        // continues without resolving and typing nodes as they are parsed
+        void detach() noexcept {
+            resolver_ = nullptr;
+            type_solver_ = nullptr;
+            scope_ = nullptr;
+        }
 
 
         tl::expected<symbol_or_expression, error_info> parse_definition_or_expression() {
-            auto expected_token = scanner_.next();
-            if(!expected_token)
-                return tl::make_unexpected(expected_token.error());
             auto expected_symbol = tl::expected<symbol, error_info>{};
             auto expected_expression = tl::expected<ast_node*, error_info>{};
-            switch(expected_token->tag) {
+            switch(peek()) {
                 case token_tag::keyword_let:
+                    ++cursor_;
                     expected_symbol = parse_value_definition();
                     if(!expected_symbol)
                         return tl::make_unexpected(expected_symbol.error());
                     return {*expected_symbol};
                 case token_tag::keyword_type:
+                    ++cursor_;
                     expected_symbol = parse_type_definition();
                     if(!expected_symbol)
                         return tl::make_unexpected(expected_symbol.error());
                     return {*expected_symbol};
                 default:
-                    scanner_.back();
                     expected_expression = parse_expression();
                     if(!expected_expression)
                         return tl::make_unexpected(expected_expression.error());
@@ -56,22 +82,63 @@ namespace mandalang {
 
 
         tl::expected<ast_node*, error_info> parse_expression() {
-            auto const expected_token = scanner_.next();
-            if(!expected_token)
-                return tl::make_unexpected(expected_token.error());
-            switch(expected_token->tag) {
+            switch(peek()) {
                 case token_tag::keyword_fn:
+                    ++cursor_;
                     return parse_function();
                 case token_tag::keyword_if:
+                    ++cursor_;
                     return parse_conditional();
                 default:
-                    scanner_.back();
                     return parse_comparison();
             }
         }
 
     private:
 
+        token_tag peek() const noexcept {
+            return tokens_.tag(cursor_);
+        }
+
+
+        unsigned current_line_no() const noexcept {
+            return tokens_.line_no(cursor_ - 1);
+        }
+
+
+        tl::expected<token, error_info> next() noexcept {
+            return tokens_.at(cursor_++);
+        }
+
+
+        tl::expected<token, error_info> next(token_tag tag, error e) noexcept {
+            auto const token = next();
+            if(!token)
+                return token;
+            if(token->tag != tag)
+                return failed(e, token->line_no);
+            return token;
+        }
+
+
+        void back() noexcept {
+            --cursor_;
+        }
+
+
+
+        tl::expected<ast_node*, error_info> bind(ast_node* node) {
+            if(!resolver_)
+                return {node};
+            auto const resolved = resolver_->resolve_node(*scope_, node);
+            if(!resolved)
+                return tl::make_unexpected(resolved.error());
+            auto const solved = type_solver_->solve_node(node);
+            if(!solved)
+                return tl::make_unexpected(solved.error());
+            return {node};
+        }
+
 
         static tl::optional<ast_node_tag> additive_operator(token_tag tag) noexcept {
             switch(tag) {
@@ -118,11 +185,11 @@ namespace mandalang {
 
 
         tl::expected<symbol, error_info> parse_value_definition() {
-            auto expected_token = scanner_.next(token_tag::name, error::expected_value_name);
+            auto expected_token = next(token_tag::name, error::expected_value_name);
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             auto const value_name = expected_token->name;
-            expected_token = scanner_.next(token_tag::equals, error::expected_equals);
+            expected_token = next(token_tag::equals, error::expected_equals);
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             auto const expected_expression = parse_expression();
@@ -133,11 +200,11 @@ namespace mandalang {
 
 
         tl::expected<symbol, error_info> parse_type_definition() {
-            auto expected_token = scanner_.next(token_tag::name, error::expected_type_name);
+            auto expected_token = next(token_tag::name, error::expected_type_name);
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             auto const type_name = expected_token->name;
-            expected_token = scanner_.next(token_tag::equals, error::expected_equals);
+            expected_token = next(token_tag::equals, error::expected_equals);
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             auto const expected_type = parse_type();
@@ -151,35 +218,50 @@ namespace mandalang {
             auto const expected_header = parse_function_header();
             if(!expected_header)
                 return expected_header;
+            auto* function_node = *expected_header;
+            auto* outer_scope = scope_;
+            if(resolver_) {
+                auto const expected_scope = resolver_->open_function(*scope_, function_node);
+                if(!expected_scope)
+                    return tl::make_unexpected(expected_scope.error());
+                scope_ = *expected_scope;
+                auto const solved = type_solver_->solve_function_header(function_node);
+                if(!solved) {
+                    scope_ = outer_scope;
+                    resolver_->close_function();
+                    return tl::make_unexpected(solved.error());
+                }
+            }
             auto const expected_body = parse_expression();
+            if(resolver_) {
+                scope_ = outer_scope;
+                resolver_->close_function();
+            }
             if(!expected_body)
                 return failed(error::expected_expression_after_function_header, expected_body.error().line);
-            auto function_node = nodes_.create((*expected_header)->function.arity,
-                                               (*expected_header)->function.parameters,
-                                               (*expected_header)->function.result,
-                                               *expected_body, (*expected_header)->line_no);
-            return {function_node};
+            function_node->function.body = *expected_body;
+            return bind(function_node);
         }
 
 
         tl::expected<ast_node*, error_info> parse_conditional() {
-            auto const line_no = scanner_.line_no();
+            auto const line_no = current_line_no();
             auto const expected_condition = parse_expression();
             if(!expected_condition)
                 return expected_condition;
-            auto expected_token = scanner_.next();
+            auto expected_token = next();
             if(!expected_token || expected_token->tag != token_tag::keyword_then)
                 return failed(error::expected_keyword_then, expected_token->line_no);
             auto const expected_then_branch = parse_expression();
             if(!expected_then_branch)
                 return expected_then_branch;
-            expected_token = scanner_.next();
+            expected_token = next();
             if(!expected_token || expected_token->tag != token_tag::keyword_else)
                 return failed(error::expected_keyword_else, expected_token->line_no);
             auto const expected_else_branch = parse_expression();
             if(!expected_else_branch)
                 return expected_else_branch;
-            return {nodes_.create(*expected_condition, *expected_then_branch, *expected_else_branch, line_no)};
+            return bind(nodes_.create(*expected_condition, *expected_then_branch, *expected_else_branch, line_no));
         }
 
 
@@ -187,7 +269,7 @@ namespace mandalang {
             auto expected_boolean_term = parse_boolean_term();
             if(!expected_boolean_term)
                 return expected_boolean_term;
-            auto expected_token = scanner_.next();
+            auto expected_token = next();
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             auto maybe_comparison = comparison_operator(expected_token->tag);
@@ -195,9 +277,9 @@ namespace mandalang {
                     auto another_boolean_term = parse_boolean_term();
                     if(!another_boolean_term)
                         return another_boolean_term;
-                    return {nodes_.create(*maybe_comparison, *expected_boolean_term, *another_boolean_term, expected_token->line_no)};
+                    return bind(nodes_.create(*maybe_comparison, *expected_boolean_term, *another_boolean_term, expected_token->line_no));
             }
-            scanner_.back();
+            back();
             return expected_boolean_term;
         }
 
@@ -206,7 +288,7 @@ namespace mandalang {
             auto expected_boolean_factor = parse_boolean_factor();
             if(!expected_boolean_factor)
                 return expected_boolean_factor;
-            auto expected_token = scanner_.next();
+            auto expected_token = next();
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             while(expected_token->tag == token_tag::double_vertical) {
@@ -214,12 +296,14 @@ namespace mandalang {
                 if(!another_boolean_factor)
                     return another_boolean_factor;
                 auto operator_node = nodes_.create(ast_node_tag::boolean_or, *expected_boolean_factor, *another_boolean_factor, expected_token->line_no);
-                expected_boolean_factor = operator_node;
-                expected_token = scanner_.next();
+                expected_boolean_factor = bind(operator_node);
+                if(!expected_boolean_factor)
+                    return expected_boolean_factor;
+                expected_token = next();
                 if(!expected_token)
                     return tl::make_unexpected(expected_token.error());
             }
-            scanner_.back();
+            back();
             return expected_boolean_factor;
         }
 
@@ -228,7 +312,7 @@ namespace mandalang {
             auto expected_term = parse_term();
             if(!expected_term)
                 return expected_term;
-            auto expected_token = scanner_.next();
+            auto expected_token = next();
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             while(expected_token->tag == token_tag::double_ampersand) {
@@ -236,12 +320,14 @@ namespace mandalang {
                 if(!another_term)
                     return another_term;
                 auto operator_node = nodes_.create(ast_node_tag::boolean_and, *expected_term, *another_term, expected_token->line_no);
-                expected_term = operator_node;
-                expected_token = scanner_.next();
+                expected_term = bind(operator_node);
+                if(!expected_term)
+                    return expected_term;
+                expected_token = next();
                 if(!expected_token)
                     return tl::make_unexpected(expected_token.error());
             }
-            scanner_.back();
+            back();
             return expected_term;
         }
 
@@ -250,7 +336,7 @@ namespace mandalang {
             auto expected_term = parse_factor();
             if(!expected_term)
                 return expected_term;
-            auto expected_token = scanner_.next();
+            auto expected_token = next();
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             auto maybe_additive = additive_operator(expected_token->tag);
@@ -259,43 +345,42 @@ namespace mandalang {
                 if(!another_expected_term)
                     return another_expected_term;
                 auto operator_node = nodes_.create(*maybe_additive, *expected_term, *another_expected_term, expected_token->line_no);
-                expected_term = operator_node;
-                expected_token = scanner_.next();
+                expected_term = bind(operator_node);
+                if(!expected_term)
+                    return expected_term;
+                expected_token = next();
                 if(!expected_token)
                     return tl::make_unexpected(expected_token.error());
                 maybe_additive = additive_operator(expected_token->tag);
             }
-            scanner_.back();
+            back();
             return expected_term;
         }
 
 
         tl::expected<ast_node*, error_info> parse_function_header() {
-            auto expected_token = scanner_.next(token_tag::left_parenthesis, error::expected_left_parenthesis);
+            auto expected_token = next(token_tag::left_parenthesis, error::expected_left_parenthesis);
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             auto const line_no = expected_token->line_no;
             auto arity = 0u;
             auto parameters = (ast_node*)nullptr;
 
-            expected_token = scanner_.next();
-            if(!expected_token)
-                return tl::make_unexpected(expected_token.error());
-
-            if(expected_token->tag != token_tag::right_parenthesis) {
-                scanner_.back();
+            if(peek() == token_tag::right_parenthesis) {
+                ++cursor_;
+            } else {
                 auto expected_parameters = parse_typed_names(arity);
                 if(!expected_parameters)
                     return expected_parameters;
                 parameters = *expected_parameters;
-                expected_token = scanner_.next();
+                expected_token = next();
                 if(!expected_token)
                     return tl::make_unexpected(expected_token.error());
                 if(expected_token->tag != token_tag::right_parenthesis)
                     return failed(error::expected_right_parenthesis, expected_token->line_no);
             }
 
-            expected_token = scanner_.next();
+            expected_token = next();
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             if(expected_token->tag != token_tag::minus_greater)
@@ -313,7 +398,7 @@ namespace mandalang {
             auto expected_factor = parse_unary();
             if(!expected_factor)
                 return expected_factor;
-            auto expected_token = scanner_.next();
+            auto expected_token = next();
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             auto maybe_multiplicative = multiplicative_operator(expected_token->tag);
@@ -322,13 +407,15 @@ namespace mandalang {
                 if(!another_expected_factor)
                     return another_expected_factor;
                 auto operator_node = nodes_.create(*maybe_multiplicative, *expected_factor, *another_expected_factor, expected_token->line_no);
-                expected_factor = operator_node;
-                expected_token = scanner_.next();
+                expected_factor = bind(operator_node);
+                if(!expected_factor)
+                    return expected_factor;
+                expected_token = next();
                 if(!expected_token)
                     return tl::make_unexpected(expected_token.error());
                 maybe_multiplicative = multiplicative_operator(expected_token->tag);
             }
-            scanner_.back();
+            back();
             return expected_factor;
         }
 
@@ -341,7 +428,7 @@ namespace mandalang {
             ++count;
             auto first_typed_name = *expected_typed_name;
             auto last_typed_name = first_typed_name;
-            auto expected_token = scanner_.next();
+            auto expected_token = next();
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             while(expected_token->tag == token_tag::comma) {
@@ -351,14 +438,17 @@ namespace mandalang {
                 ++count;
                 last_typed_name->typed_name.next = *expected_typed_name;
                 last_typed_name = *expected_typed_name;
+                expected_token = next();
+                if(!expected_token)
+                    return tl::make_unexpected(expected_token.error());
             }
-            scanner_.back();
+            back();
             return first_typed_name;
         }
 
 
         tl::expected<ast_node*, error_info> parse_type() {
-            auto expected_token = scanner_.next();
+            auto expected_token = next();
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             auto expected_type = tl::expected<ast_node*, error_info>{};
@@ -369,14 +459,16 @@ namespace mandalang {
                     expected_type = parse_type();
                     if(!expected_type)
                         return expected_type;
-                    expected_token = scanner_.next(token_tag::right_parenthesis, error::unclosed_parenthesis_in_expression);
+                    expected_token = next(token_tag::right_parenthesis, error::unclosed_parenthesis_in_expression);
                     if(!expected_token)
                         return tl::make_unexpected(expected_token.error());
                     return expected_type;
                 case token_tag::keyword_fn:
                     return parse_function_type();
                 case token_tag::keyword_vector:
-                    return parse_vector_type();
+                    return parse_vector_type(ast_node_tag::type_vector);
+                case token_tag::keyword_persistent:
+                    return parse_vector_type(ast_node_tag::type_persistent);
                 default:
                     return failed(error::invalid_type_syntax, expected_token->line_no);
             }
@@ -384,7 +476,7 @@ namespace mandalang {
 
 
         tl::expected<ast_node*, error_info> parse_unary() {
-            auto expected_token = scanner_.next();
+            auto expected_token = next();
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             switch(expected_token->tag) {
@@ -400,10 +492,16 @@ namespace mandalang {
                     return parse_floating_point(*expected_token);
                 case token_tag::integer:
                     return parse_integer(*expected_token);
+                case token_tag::floating_point_vector:
+                    return bind(nodes_.create(ast_node_tag::floating_point_vector, expected_token->vector, expected_token->line_no));
+                case token_tag::integer_vector:
+                    return bind(nodes_.create(ast_node_tag::integer_vector, expected_token->vector, expected_token->line_no));
+                case token_tag::left_square_brace:
+                    return parse_vector_literal();
                 case token_tag::name:
                     return parse_name_and_optional_calls(*expected_token);
                 default:
-                    return failed(error::invalid_expression, scanner_.line_no());
+                    return failed(error::invalid_expression, current_line_no());
             }
         }
 
@@ -412,7 +510,7 @@ namespace mandalang {
             auto expected_type = parse_type();
             if(!expected_type)
                 return expected_type;
-            auto expected_name = scanner_.next(token_tag::name, error::expected_parameter_name);
+            auto expected_name = next(token_tag::name, error::expected_parameter_name);
             if(!expected_name)
                 return tl::make_unexpected(expected_name.error());
             auto typed_name_node = nodes_.create(*expected_type, expected_name->name, expected_name->line_no);
@@ -421,22 +519,22 @@ namespace mandalang {
 
 
         tl::expected<ast_node*, error_info> parse_function_type() {
-            auto expected_token = scanner_.next(token_tag::left_parenthesis, error::expected_left_parenthesis);
+            auto expected_token = next(token_tag::left_parenthesis, error::expected_left_parenthesis);
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             auto const line_no = expected_token->line_no;
             unsigned arity = 0;
             auto parameters = (ast_node*)nullptr;
-            expected_token = scanner_.next();
-            if(expected_token->tag != token_tag::right_parenthesis) {
-                scanner_.back();
+            if(peek() == token_tag::right_parenthesis) {
+                ++cursor_;
+            } else {
                 auto expected_type = parse_type();
                 if(!expected_type)
                     return expected_type;
                 ++arity;
                 parameters = nodes_.create(*expected_type, (*expected_type)->line_no);
                 auto last_parameter = parameters;
-                expected_token = scanner_.next();
+                expected_token = next();
                 if(!expected_token)
                     return tl::make_unexpected(expected_token.error());
                 while(expected_token->tag == token_tag::comma) {
@@ -446,14 +544,14 @@ namespace mandalang {
                     ++arity;
                     last_parameter->type_item.next = nodes_.create(*expected_type, (*expected_type)->line_no);
                     last_parameter = last_parameter->type_item.next;
-                    expected_token = scanner_.next();
+                    expected_token = next();
                     if(!expected_token)
                         return tl::make_unexpected(expected_token.error());
                 }
                 if(expected_token->tag != token_tag::right_parenthesis)
                     return failed(error::expected_comma_or_right_parenthesis, expected_token->line_no);
             }
-            expected_token = scanner_.next(token_tag::minus_greater, error::expected_arrow);
+            expected_token = next(token_tag::minus_greater, error::expected_arrow);
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             auto expected_result = parse_type();
@@ -463,28 +561,28 @@ namespace mandalang {
         }
 
 
-        tl::expected<ast_node*, error_info> parse_vector_type() {
-            auto expected_token = scanner_.next(token_tag::left_square_brace, error::expected_left_square_brace);
+        tl::expected<ast_node*, error_info> parse_vector_type(ast_node_tag tag) {
+            auto expected_token = next(token_tag::left_square_brace, error::expected_left_square_brace);
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             auto const line_no = expected_token->line_no;
             auto expected_type = parse_type();
             if(!expected_type)
                 return expected_type;
-            expected_token = scanner_.next(token_tag::right_square_brace, error::expected_right_square_brace);
+            expected_token = next(token_tag::right_square_brace, error::expected_right_square_brace);
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
-            return {nodes_.create(ast_node_tag::type_vector, *expected_type, line_no)};
+            return {nodes_.create(tag, *expected_type, line_no)};
         }
 
 
         tl::expected<ast_node*, error_info> parse_unary_operator(ast_node_tag tag) {
-            auto const line_no = scanner_.line_no();
+            auto const line_no = current_line_no();
             auto expected_factor = parse_unary();
             if(!expected_factor)
                 return expected_factor;
             auto negative_node = nodes_.create(tag, *expected_factor, line_no);
-            return {negative_node};
+            return bind(negative_node);
         }
 
 
@@ -497,27 +595,57 @@ namespace mandalang {
 
 
         tl::expected<ast_node*, error_info> parse_subexpression() {
-            auto const line_no = scanner_.line_no();
+            auto const line_no = current_line_no();
             auto expected_node = parse_expression();
             if(!expected_node)
                 return expected_node;
-            auto const expected_token = scanner_.next();
+            auto const expected_token = next();
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             if(expected_token->tag != token_tag::right_parenthesis)
-                return failed(error::unclosed_parenthesis_in_expression, scanner_.line_no());
+                return failed(error::unclosed_parenthesis_in_expression, current_line_no());
             auto subexpression_node = nodes_.create(ast_node_tag::subexpression, *expected_node, line_no);
-            return {subexpression_node};
+            return bind(subexpression_node);
+        }
+
+
+        tl::expected<ast_node*, error_info> parse_vector_literal() {
+            auto const line_no = current_line_no();
+            if(peek() == token_tag::right_square_brace)
+                return failed(error::empty_vector_literal, line_no);
+            auto size = 0u;
+            auto* items = (ast_node*)nullptr;
+            auto* last_item = (ast_node*)nullptr;
+            for(;;) {
+                auto const expected_item = parse_expression();
+                if(!expected_item)
+                    return expected_item;
+                auto* item_node = nodes_.create(ast_node_tag::vector_item, *expected_item, nullptr, (*expected_item)->line_no);
+                if(last_item)
+                    last_item->binary.right = item_node;
+                else
+                    items = item_node;
+                last_item = item_node;
+                ++size;
+                auto const expected_token = next();
+                if(!expected_token)
+                    return tl::make_unexpected(expected_token.error());
+                if(expected_token->tag == token_tag::right_square_brace)
+                    break;
+                if(expected_token->tag != token_tag::comma)
+                    return failed(error::expected_comma_or_right_square_brace, expected_token->line_no);
+            }
+            return bind(nodes_.create(size, items, line_no));
         }
 
 
         tl::expected<ast_node*, error_info> parse_floating_point(token token) {
-            return {nodes_.create(token.floating_point, token.line_no)};
+            return bind(nodes_.create(token.floating_point, token.line_no));
         }
 
 
         tl::expected<ast_node*, error_info> parse_integer(token token) {
-            return {nodes_.create(token.integer, token.line_no)};
+            return bind(nodes_.create(token.integer, token.line_no));
         }
 
 
@@ -530,13 +658,13 @@ namespace mandalang {
 
 
         tl::expected<ast_node*, error_info> parse_name(token token) {
-            return {nodes_.create(token.name, token.line_no)};
+            return bind(nodes_.create(token.name, token.line_no));
         }
 
 
         tl::expected<ast_node*, error_info> parse_optional_calls(ast_node* node) {
             ast_node* call_node = node;
-            auto expected_token = scanner_.next();
+            auto expected_token = next();
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             while(expected_token->tag == token_tag::left_parenthesis) {
@@ -544,31 +672,35 @@ namespace mandalang {
                 auto expected_arguments = parse_arguments(arguments_count);
                 if(!expected_arguments)
                     return expected_arguments;
-                call_node = nodes_.create(call_node, arguments_count, *expected_arguments, call_node->line_no);
-                expected_token = scanner_.next();
+                auto expected_call = bind(nodes_.create(call_node, arguments_count, *expected_arguments, call_node->line_no));
+                if(!expected_call)
+                    return expected_call;
+                call_node = *expected_call;
+                expected_token = next();
                 if(!expected_token)
                     return tl::make_unexpected(expected_token.error());
             }
-            scanner_.back();
+            back();
             return {call_node};
         }
 
 
         tl::expected<ast_node*, error_info> parse_arguments(unsigned& arguments_count) {
             arguments_count = 0;
-            auto expected_token = scanner_.next();
+            auto expected_token = tokens_.at(cursor_);
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
-            if(expected_token->tag == token_tag::right_parenthesis)
+            if(expected_token->tag == token_tag::right_parenthesis) {
+                ++cursor_;
                 return nullptr;
-            scanner_.back();
+            }
             auto expected_expression = parse_expression();
             if(!expected_expression)
                 return failed(error::expected_argument_or_right_parenthesis, expected_token->line_no);
             auto* arguments_node = nodes_.create(ast_node_tag::function_argument, *expected_expression, nullptr, (*expected_expression)->line_no);
             auto* current_argument = arguments_node;
             ++arguments_count;
-            expected_token = scanner_.next();
+            expected_token = next();
             if(!expected_token)
                 return tl::make_unexpected(expected_token.error());
             while(expected_token->tag != token_tag::right_parenthesis) {
@@ -581,7 +713,7 @@ namespace mandalang {
                 current_argument->binary.right = argument_node;
                 current_argument = argument_node;
                 ++arguments_count;
-                expected_token = scanner_.next();
+                expected_token = next();
                 if(!expected_token)
                     return tl::make_unexpected(expected_token.error());
             }
@@ -0,0 +1,282 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <utility>
+
+
+namespace mandalang {
+
+
+    // node of a persistent vector: leaves hold packed items which follow the header, inner
+    // nodes join two subtrees whose heights differ by one at most; nodes are never changed
+    // after they are made, so versions of a vector share all nodes but the copied paths;
+    // values of globals are shared between loader threads, so counting is atomic
+    struct persistent_node {
+        static constexpr std::size_t alignment = 32;
+        static constexpr std::size_t leaf_capacity = 64;
+
+        std::atomic<std::size_t> references;
+        std::size_t size;
+        unsigned height;
+        persistent_node* left;
+        persistent_node* right;
+
+
+        static std::size_t header_size() noexcept {
+            return (sizeof(persistent_node) + alignment - 1) / alignment * alignment;
+        }
+
+
+        bool leaf() const noexcept {
+            return height == 0;
+        }
+
+
+        template<typename T> T* items() noexcept {
+            return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + header_size());
+        }
+
+        template<typename T> T const* items() const noexcept {
+            return reinterpret_cast<T const*>(reinterpret_cast<char const*>(this) + header_size());
+        }
+
+
+        // empty vectors have no nodes
+        static void retain(persistent_node* node) noexcept {
+            if(node)
+                node->references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+
+        static void release(persistent_node* node) noexcept {
+            if(!node || node->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            release(node->left);
+            release(node->right);
+            node->~persistent_node();
+            ::operator delete(node, std::align_val_t{alignment});
+        }
+
+    }; // persistent_node
+
+
+    // owning handle of a persistent vector root outside of values
+    class persistent_reference {
+        persistent_node* node_{nullptr};
+
+    public:
+
+        persistent_reference() noexcept = default;
+        explicit persistent_reference(persistent_node* adopted) noexcept: node_{adopted} { }
+
+        persistent_reference(persistent_reference const& other) noexcept: node_{other.node_} {
+            persistent_node::retain(node_);
+        }
+
+        persistent_reference(persistent_reference&& other) noexcept: node_{other.node_} {
+            other.node_ = nullptr;
+        }
+
+        persistent_reference& operator = (persistent_reference other) noexcept {
+            std::swap(node_, other.node_);
+            return *this;
+        }
+
+        ~persistent_reference() {
+            persistent_node::release(node_);
+        }
+
+        persistent_node* get() const noexcept { return node_; }
+
+        persistent_node* detach() noexcept { return std::exchange(node_, nullptr); }
+
+    }; // persistent_reference
+
+
+} // namespace mandalang
+
+
+// operations take roots they read without adopting them and return new roots,
+// which share unchanged subtrees with the roots read
+
+
+namespace mandalang::persistent_vector {
+
+
+    inline std::size_t size_of(persistent_node const* node) noexcept {
+        return node ? node->size : 0;
+    }
+
+
+    inline int height_of(persistent_node const* node) noexcept {
+        return node ? int(node->height) : -1;
+    }
+
+
+    inline persistent_reference shared(persistent_node* node) noexcept {
+        persistent_node::retain(node);
+        return persistent_reference{node};
+    }
+
+
+    // items of a new leaf are left for the caller to fill
+    inline persistent_reference allocate_leaf(std::size_t count, std::size_t item_size) {
+        auto* memory = ::operator new(persistent_node::header_size() + count * item_size,
+                                      std::align_val_t{persistent_node::alignment});
+        return persistent_reference{new(memory) persistent_node{1, count, 0, nullptr, nullptr}};
+    }
+
+
+    inline persistent_reference leaf(void const* items, std::size_t count, std::size_t item_size) {
+        if(count == 0)
+            return {};
+        auto made = allocate_leaf(count, item_size);
+        std::memcpy(made.get()->items<char>(), items, count * item_size);
+        return made;
+    }
+
+
+    // a leaf of two runs of items
+    inline persistent_reference leaf(void const* first, std::size_t first_count, void const* second, std::size_t second_count,
+                                     std::size_t item_size) {
+        auto joined = allocate_leaf(first_count + second_count, item_size);
+        std::memcpy(joined.get()->items<char>(), first, first_count * item_size);
+        std::memcpy(joined.get()->items<char>() + first_count * item_size, second, second_count * item_size);
+        return joined;
+    }
+
+
+    inline persistent_reference inner(persistent_node* left, persistent_node* right) {
+        auto* memory = ::operator new(persistent_node::header_size(), std::align_val_t{persistent_node::alignment});
+        persistent_node::retain(left);
+        persistent_node::retain(right);
+        return persistent_reference{new(memory) persistent_node{
+                1, left->size + right->size, unsigned(std::max(left->height, right->height) + 1), left, right}};
+    }
+
+
+    // joins subtrees whose heights differ by two at most, rotating as an avl tree does
+    inline persistent_reference balanced(persistent_node* left, persistent_node* right) {
+        auto const left_height = height_of(left);
+        auto const right_height = height_of(right);
+        if(left_height > right_height + 1) {
+            if(height_of(left->left) >= height_of(left->right))
+                return inner(left->left, inner(left->right, right).get());
+            return inner(inner(left->left, left->right->left).get(), inner(left->right->right, right).get());
+        }
+        if(right_height > left_height + 1) {
+            if(height_of(right->right) >= height_of(right->left))
+                return inner(inner(left, right->left).get(), right->right);
+            return inner(inner(left, right->left->left).get(), inner(right->left->right, right->right).get());
+        }
+        return inner(left, right);
+    }
+
+
+    // descends the taller tree to a subtree as high as the other one,
+    // so the cost is the difference of heights; small leaves are merged
+    inline persistent_reference join(persistent_node* left, persistent_node* right, std::size_t item_size) {
+        if(!left)
+            return shared(right);
+        if(!right)
+            return shared(left);
+        if(left->leaf() && right->leaf() && left->size + right->size <= persistent_node::leaf_capacity)
+            return leaf(left->items<char>(), left->size, right->items<char>(), right->size, item_size);
+        if(height_of(left) > height_of(right) + 1)
+            return balanced(left->left, join(left->right, right, item_size).get());
+        if(height_of(right) > height_of(left) + 1)
+            return balanced(join(left, right->left, item_size).get(), right->right);
+        return inner(left, right);
+    }
+
+
+    // first count items and the rest
+    inline std::pair<persistent_reference, persistent_reference> split(persistent_node* node, std::size_t count,
+                                                                       std::size_t item_size) {
+        if(count == 0)
+            return {persistent_reference{}, shared(node)};
+        if(count >= size_of(node))
+            return {shared(node), persistent_reference{}};
+        if(node->leaf())
+            return {leaf(node->items<char>(), count, item_size),
+                    leaf(node->items<char>() + count * item_size, node->size - count, item_size)};
+        if(count < node->left->size) {
+            auto [first, rest] = split(node->left, count, item_size);
+            return {std::move(first), join(rest.get(), node->right, item_size)};
+        }
+        auto [first, rest] = split(node->right, count - node->left->size, item_size);
+        return {join(node->left, first.get(), item_size), std::move(rest)};
+    }
+
+
+    inline persistent_reference slice(persistent_node* node, std::size_t begin, std::size_t end, std::size_t item_size) {
+        auto head = split(node, end, item_size).first;
+        return split(head.get(), begin, item_size).second;
+    }
+
+
+    inline persistent_reference push(persistent_node* node, void const* item, std::size_t item_size) {
+        if(!node)
+            return leaf(item, 1, item_size);
+        if(node->leaf()) {
+            if(node->size == persistent_node::leaf_capacity)
+                return inner(node, leaf(item, 1, item_size).get());
+            return leaf(node->items<char>(), node->size, item, 1, item_size);
+        }
+        return balanced(node->left, push(node->right, item, item_size).get());
+    }
+
+
+    // index is below the size
+    inline persistent_reference set(persistent_node* node, std::size_t index, void const* item, std::size_t item_size) {
+        if(node->leaf()) {
+            auto changed = leaf(node->items<char>(), node->size, item_size);
+            std::memcpy(changed.get()->items<char>() + index * item_size, item, item_size);
+            return changed;
+        }
+        if(index < node->left->size)
+            return inner(set(node->left, index, item, item_size).get(), node->right);
+        return inner(node->left, set(node->right, index - node->left->size, item, item_size).get());
+    }
+
+
+    // leaves of equal size but the last one, paired level by level
+    inline persistent_reference build(void const* items, std::size_t count, std::size_t item_size) {
+        if(count <= persistent_node::leaf_capacity)
+            return leaf(items, count, item_size);
+        auto const leaves = (count + persistent_node::leaf_capacity - 1) / persistent_node::leaf_capacity;
+        auto const left_count = leaves / 2 * persistent_node::leaf_capacity;
+        auto const left = build(items, left_count, item_size);
+        auto const right = build(static_cast<char const*>(items) + left_count * item_size, count - left_count, item_size);
+        return inner(left.get(), right.get());
+    }
+
+
+    // calls visit(items, count) for leaves in order
+    template<typename F> void for_each_leaf(persistent_node const* node, F&& visit) {
+        if(!node)
+            return;
+        if(node->leaf()) {
+            visit(node->items<char>(), node->size);
+            return;
+        }
+        for_each_leaf(node->left, visit);
+        for_each_leaf(node->right, visit);
+    }
+
+
+    inline void copy_items(persistent_node const* node, void* to, std::size_t item_size) noexcept {
+        auto* cursor = static_cast<char*>(to);
+        for_each_leaf(node, [&](char const* items, std::size_t count) {
+            std::memcpy(cursor, items, count * item_size);
+            cursor += count * item_size;
+        });
+    }
+
+
+} // namespace mandalang::persistent_vector
@@ -1,6 +1,9 @@
 #pragma once
 
 
+#include <functional>
+#include <vector>
+
 #include <nonstd/memory_pool.hpp>
 #include <tl/expected.hpp>
 
@@ -14,21 +17,47 @@ namespace mandalang {
 
 
     class resolver {
+        nonstd::memory_pool<ast_node>& nodes_;
         nonstd::memory_pool<scope>& scopes_;
         nonstd::memory_pool<symbol>& symbols_;
+        unsigned level_{0};
+        // open functions by level
+        std::vector<ast_node*> functions_;
+        symbol const* hidden_begin_{nullptr};
+        symbol const* hidden_end_{nullptr};
+        std::vector<symbol const*>* reads_{nullptr};
     public:
 
-        resolver(nonstd::memory_pool<scope>& scopes, nonstd::memory_pool<symbol>& symbols) noexcept
-        : scopes_{scopes}, symbols_{symbols} { }
+        resolver(nonstd::memory_pool<ast_node>& nodes, nonstd::memory_pool<scope>& scopes,
+                 nonstd::memory_pool<symbol>& symbols) noexcept
+        : nodes_{nodes}, scopes_{scopes}, symbols_{symbols} { }
+
+
+        // symbols of the range are unknown names, as lazily compiled definitions never
+        // see definitions which come after them in their module
+        void hide(symbol const* begin, symbol const* end) noexcept {
+            hidden_begin_ = begin;
+            hidden_end_ = end;
+        }
+
+
+        // globals bound to a global slot are appended to reads, function bodies included
+        void record_reads(std::vector<symbol const*>* reads) noexcept {
+            reads_ = reads;
+        }
 
 
-        tl::expected<void, error_info> resolve_expression(scope& scope, ast_node* node, unsigned depth = 0) {
+        tl::expected<void, error_info> resolve_expression(scope& scope, ast_node* node) {
             switch(node->tag) {
                 case ast_node_tag::floating_point:
                 case ast_node_tag::integer:
+                case ast_node_tag::floating_point_vector:
+                case ast_node_tag::integer_vector:
                     return {};
                 case ast_node_tag::name:
                     return resolve_name(scope, node);
+                case ast_node_tag::vector_literal:
+                    return resolve_vector_literal(scope, node);
                 case ast_node_tag::subexpression:
                 case ast_node_tag::negate:
                 case ast_node_tag::boolean_not:
@@ -52,42 +81,40 @@ namespace mandalang {
                     return resolve_function_call(scope, node);
                 case ast_node_tag::conditional:
                     return resolve_conditional(scope, node);
+                case ast_node_tag::type_function:
+                case ast_node_tag::type_vector:
+                case ast_node_tag::type_persistent:
+                    return resolve_type(scope, node);
                 default:
                     return failed(error::invalid_ast_node_to_resolve, node->line_no);
             }
         }
 
 
-    private:
-
-        tl::expected<void, error_info> resolve_name(scope& scope, ast_node* node) noexcept {
-            auto const* symbol_ptr = scope.find(node->name);
-            if(!symbol_ptr)
-                return failed(error::unknown_name, node->line_no, node->name);
-            node->tag = ast_node_tag::resolved_name;
-            node->resolved_name = symbol_ptr;
-            return {};
-        }
-
-
-        tl::expected<void, error_info> resolve_binary_operation(scope& scope, ast_node* left, ast_node* right) noexcept {
-            auto const left_resolved = resolve_expression(scope, left);
-            if(!left_resolved)
-                return left_resolved;
-            auto const right_resolved = resolve_expression(scope, right);
-            if(!right_resolved)
-                return right_resolved;
-            return {};
+        // resolves a single node whose operands are resolved already, used by single pass parsing
+        tl::expected<void, error_info> resolve_node(scope& scope, ast_node* node) {
+            switch(node->tag) {
+                case ast_node_tag::name:
+                    return resolve_name(scope, node);
+                case ast_node_tag::function_call:
+                    node->tag = ast_node_tag::resolved_function_call;
+                    return {};
+                default:
+                    return {};
+            }
         }
 
 
-        tl::expected<void, error_info> resolve_function(scope& scope, ast_node* node) {
+        // defines self and parameters of a function in a new local scope, which is used
+        // to resolve the function body until close_function is called
+        tl::expected<scope*, error_info> open_function(scope& scope, ast_node* node) {
             auto resolved = resolve_type(scope, node->function.result);
             if(!resolved)
-                return resolved;
+                return tl::make_unexpected(resolved.error());
             auto* local_scope = scopes_.create(&scope);
             node->function.scope = local_scope;
-            auto* self = symbols_.create("self", value{type{}, node->function.body});
+            node->function.level = level_;
+            auto* self = symbols_.create(self_name, value{type{}, node});
             local_scope->define(self);
 
             auto parameter_index = 0u;
@@ -96,9 +123,9 @@ namespace mandalang {
                 each_parameter = each_parameter->typed_name.next) {
                 resolved = resolve_type(scope, each_parameter->typed_name.type);
                 if(!resolved)
-                    return resolved;
+                    return tl::make_unexpected(resolved.error());
                 auto* parameter_symbol = symbols_.create(each_parameter->typed_name.name,
-                                                         parameter_index, 0);
+                                                         parameter_index, level_);
                 auto const defined = local_scope->define(parameter_symbol);
                 if(!defined)
                     return tl::make_unexpected(defined.error());
@@ -106,7 +133,109 @@ namespace mandalang {
             }
 
             node->tag = ast_node_tag::resolved_function;
-            return resolve_expression(*local_scope, node->function.body);
+            functions_.push_back(node);
+            ++level_;
+            return local_scope;
+        }
+
+
+        void close_function() noexcept {
+            functions_.pop_back();
+            --level_;
+        }
+
+
+    private:
+
+        // names of values are bound to the location they are read from at runtime:
+        // parameters of the innermost function to a local frame slot, parameters
+        // of enclosing functions to an environment slot of the value captured
+        // into the frame and values to a global slot
+        tl::expected<void, error_info> resolve_name(scope& scope, ast_node* node) {
+            auto const* symbol_ptr = scope.find(node->name.id);
+            if(!symbol_ptr || symbol_ptr->declared_only() || hidden(symbol_ptr))
+                return failed(error::unknown_name, node->line_no, node->name.text);
+            auto const compiled = compile_deferred(*symbol_ptr);
+            if(!compiled)
+                return compiled;
+            switch(symbol_ptr->tag) {
+                case symbol_tag::fn_parameter:
+                    if(symbol_ptr->function_parameter.level + 1 == level_) {
+                        node->tag = ast_node_tag::local_slot;
+                        node->slot = {symbol_ptr, nullptr,
+                                      symbol_ptr->function_parameter.index, symbol_ptr->function_parameter.level};
+                        return {};
+                    }
+                    node->tag = ast_node_tag::environment_slot;
+                    node->slot = {symbol_ptr, nullptr,
+                                  capture(level_ - 1, symbol_ptr, node->line_no), symbol_ptr->function_parameter.level};
+                    return {};
+                case symbol_tag::value:
+                    node->tag = ast_node_tag::global_slot;
+                    node->slot = {symbol_ptr, &symbol_ptr->value, 0, 0};
+                    if(reads_ != nullptr && symbol_ptr->name.id != self_name.id)
+                        reads_->push_back(symbol_ptr);
+                    return {};
+                default:
+                    node->tag = ast_node_tag::resolved_name;
+                    node->resolved_name = symbol_ptr;
+                    return {};
+            }
+        }
+
+
+        // frame slot of a parameter of an enclosing function in the function at the level,
+        // which captures the parameter from the function enclosing it, which may capture it too
+        unsigned capture(unsigned level, symbol const* parameter, unsigned line_no) {
+            auto* function = functions_[level];
+            auto index = function->function.arity;
+            auto** link = &function->function.captures;
+            for(; *link != nullptr; link = &(*link)->binary.right, ++index)
+                if((*link)->binary.left->slot.source == parameter)
+                    return index;
+            auto const outer_level = level - 1;
+            auto const local = parameter->function_parameter.level == outer_level;
+            auto* read = nodes_.create(local ? ast_node_tag::local_slot : ast_node_tag::environment_slot, line_no);
+            read->slot = {parameter, nullptr,
+                          local ? parameter->function_parameter.index : capture(outer_level, parameter, line_no),
+                          parameter->function_parameter.level};
+            *link = nodes_.create(ast_node_tag::function_argument, read, nullptr, line_no);
+            return index;
+        }
+
+
+        bool hidden(symbol const* s) const noexcept {
+            auto const less = std::less<symbol const*>{};
+            return !less(s, hidden_begin_) && less(s, hidden_end_);
+        }
+
+
+        // a name of a lazily loaded definition is resolved after the definition is compiled in place
+        static tl::expected<void, error_info> compile_deferred(symbol const& s) noexcept {
+            if(s.tag != symbol_tag::deferred)
+                return {};
+            return s.deferred->compile(*s.deferred);
+        }
+
+
+        tl::expected<void, error_info> resolve_binary_operation(scope& scope, ast_node* left, ast_node* right) noexcept {
+            auto const left_resolved = resolve_expression(scope, left);
+            if(!left_resolved)
+                return left_resolved;
+            auto const right_resolved = resolve_expression(scope, right);
+            if(!right_resolved)
+                return right_resolved;
+            return {};
+        }
+
+
+        tl::expected<void, error_info> resolve_function(scope& scope, ast_node* node) {
+            auto const expected_scope = open_function(scope, node);
+            if(!expected_scope)
+                return tl::make_unexpected(expected_scope.error());
+            auto const resolved = resolve_expression(**expected_scope, node->function.body);
+            close_function();
+            return resolved;
         }
 
 
@@ -124,6 +253,16 @@ namespace mandalang {
         }
 
 
+        tl::expected<void, error_info> resolve_vector_literal(scope& scope, ast_node* node) {
+            for(auto* item = node->vector_literal.items; item != nullptr; item = item->binary.right) {
+                auto const resolved = resolve_expression(scope, item->binary.left);
+                if(!resolved)
+                    return resolved;
+            }
+            return {};
+        }
+
+
         tl::expected<void, error_info> resolve_conditional(scope& scope, ast_node* node) {
             auto resolved = resolve_expression(scope, node->conditional.condition);
             if(!resolved)
@@ -144,6 +283,9 @@ namespace mandalang {
                     return resolve_type_name(scope, node);
                 case ast_node_tag::type_function:
                     return resolve_type_function(scope, node);
+                case ast_node_tag::type_vector:
+                case ast_node_tag::type_persistent:
+                    return resolve_type(scope, node->unary);
                 default:
                     return failed(error::invalid_ast_node_to_resolve, node->line_no);
             }
@@ -151,11 +293,14 @@ namespace mandalang {
 
 
         tl::expected<void, error_info> resolve_type_name(scope& scope, ast_node* node) {
-            auto const* symbol_ptr = scope.find(node->name);
-            if(!symbol_ptr)
-                return failed(error::unknown_name, node->line_no, node->name);
+            auto const* symbol_ptr = scope.find(node->name.id);
+            if(!symbol_ptr || symbol_ptr->declared_only() || hidden(symbol_ptr))
+                return failed(error::unknown_name, node->line_no, node->name.text);
+            auto const compiled = compile_deferred(*symbol_ptr);
+            if(!compiled)
+                return compiled;
             if(symbol_ptr->tag != symbol_tag::type)
-                return failed(error::type_name_expected, node->line_no, node->name);
+                return failed(error::type_name_expected, node->line_no, node->name.text);
             node->tag = ast_node_tag::resolved_name;
             node->resolved_name = symbol_ptr;
             return {};
@@ -2,25 +2,33 @@
 
 
 #include <charconv>
+#include <optional>
+#include <string_view>
 
 #include <tl/expected.hpp>
 #include <tl/optional.hpp>
 
 #include <configure.hpp>
+#include <mandalang/character_runs.hpp>
 #include <mandalang/error_info.hpp>
+#include <mandalang/name_table.hpp>
 #include <mandalang/token.hpp>
+#include <mandalang/vector_buffer.hpp>
 
 
 namespace mandalang {
 
     class scanner {
+        static constexpr std::size_t initial_vector_capacity = 16;
+
         char const* p_{nullptr};
+        name_table* names_{nullptr};
         unsigned line_no_{1};
-        bool backward_{false};
-        token token_{};
     public:
 
-        scanner(char const* p) noexcept: p_{p} { }
+        scanner(char const* p, name_table& names) noexcept: p_{p}, names_{&names} { }
+        scanner(char const* p, name_table& names, unsigned line_no) noexcept:
+            p_{p}, names_{&names}, line_no_{line_no} { }
         scanner(scanner const&) noexcept = default;
         scanner& operator = (scanner const&) noexcept = default;
 
@@ -30,30 +38,44 @@ namespace mandalang {
 
 
         tl::expected<token, error_info> next() noexcept {
-            if(backward_) {
-                backward_ = false;
-                return token_;
-            }
-            auto const expected_token = scan();
-            if(!expected_token)
-                return expected_token;
-            token_ = *expected_token;
-            return expected_token;
-        }
-
-
-        tl::expected<token, error_info> next(token_tag tag, error e) noexcept {
-            auto const token = next();
-            if(!token)
-                return token;
-            if(token->tag != tag)
-                return failed(e, token->line_no);
-            return token;
+            return scan();
         }
 
 
-        void back() {
-            backward_ = true;
+        struct skimmed {
+            token_tag tag;
+            char const* begin;
+            unsigned line_no;
+        };
+
+        // advances over the next token without converting numbers, packing vectors or
+        // interning names; invalid characters are stepped over, so skimming never fails
+        skimmed skim() noexcept {
+            for(;;) {
+                auto const maybe_token = skip_spaces_and_comments();
+                if(maybe_token)
+                    return {maybe_token->tag, p_ - (maybe_token->tag == token_tag::minus ? 1 : 2), line_no_};
+                auto const* begin = p_;
+                if(character_runs::is_digit(*p_)) {
+                    bool is_floating_point;
+                    auto const* until = number_end(p_, is_floating_point);
+                    p_ = until != nullptr ? until : character_runs::skip_digits(p_ + 1);
+                    return {token_tag::integer, begin, line_no_};
+                }
+                if(*p_ == '[') {
+                    ++p_;
+                    return {token_tag::left_square_brace, begin, line_no_};
+                }
+                if(is_name_start(*p_)) {
+                    p_ = character_runs::skip_letters_or_digits(p_ + 1);
+                    auto const tag = keyword_tag(std::string_view{begin, std::size_t(p_ - begin)});
+                    return {tag ? *tag : token_tag::name, begin, line_no_};
+                }
+                auto const expected_token = scan();
+                if(expected_token)
+                    return {expected_token->tag, begin, line_no_};
+                p_ = begin + 1;
+            }
         }
 
 
@@ -72,8 +94,7 @@ namespace mandalang {
                     ++p_;
                     return {token{token_tag::right_parenthesis, line_no_}};
                 case '[':
-                    ++p_;
-                    return {token{token_tag::left_square_brace, line_no_}};
+                    return scan_left_square_brace_or_vector();
                 case ']':
                     ++p_;
                     return {token{token_tag::right_square_brace, line_no_}};
@@ -141,41 +162,11 @@ namespace mandalang {
                     return scan_number();
                 case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H': case 'I': case 'J':
                 case 'K': case 'L': case 'M': case 'N': case 'O': case 'P': case 'Q': case 'R': case 'S': case 'T':
-                case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z': case 'a': case 'b': case 'c':
-                case 'g': case 'h': case 'j': case 'k': case 'm': case 'n':
-                case 'o': case 'p': case 'q': case 'r': case 's': case 'u': case 'w': case 'x':
+                case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z': case 'a': case 'b': case 'c': case 'd':
+                case 'e': case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': case 'l': case 'm': case 'n':
+                case 'o': case 'p': case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x':
                 case 'y': case 'z': case '_':
-                    return scan_name();
-                case 'd':
-                    //if(try_scan_keyword('o', 'u', 'b', 'l', 'e'))
-                    //    return {token{token_tag::keyword_double, line_no_}};
-                    return scan_name();
-                case 'e':
-                    if(try_scan_keyword('l', 's', 'e'))
-                        return {token{token_tag::keyword_else, line_no_}};
-                    return scan_name();
-                case 'f':
-                    if(try_scan_keyword('n'))
-                        return {token{token_tag::keyword_fn, line_no_}};
-                    return scan_name();
-                case 'i':
-                    if(try_scan_keyword('f'))
-                        return {token{token_tag::keyword_if, line_no_}};
-                    return scan_name();
-                case 'l':
-                    if(try_scan_keyword('e', 't'))
-                        return {token{token_tag::keyword_let, line_no_}};
-                    return scan_name();
-                case 't':
-                    if(try_scan_keyword('h', 'e', 'n'))
-                        return {token{token_tag::keyword_then, line_no_}};
-                    if(try_scan_keyword('y', 'p', 'e'))
-                        return {token{token_tag::keyword_type, line_no_}};
-                    return scan_name();
-                case 'v':
-                    if(try_scan_keyword('e', 'c', 't', 'o', 'r'))
-                        return {token{token_tag::keyword_vector, line_no_}};
-                    return scan_name();
+                    return scan_name_or_keyword();
                 case '\0':
                     return {token{token_tag::stop, line_no_}};
                 default:
@@ -186,97 +177,134 @@ namespace mandalang {
 
 
         std::optional<token> skip_spaces_and_comments() noexcept {
-            // clang-format off
-            for(;;)
+            for(;;) {
+                p_ = character_runs::skip_spaces(p_, line_no_);
+                if(*p_ != '-')
+                    return std::nullopt;
+                ++p_;
                 switch(*p_) {
-                    case ' ': case '\t': case '\r':
-                        ++p_; continue;
-                    case '\n':
-                        ++p_; ++line_no_; continue;
                     case '-':
+                        // trailing '\n' is left to skip_spaces, so comment lines are counted too
+                        p_ = character_runs::skip_line(p_ + 1);
+                        continue;
+                    case '>':
                         ++p_;
-                        switch(*p_) {
-                            case '-':
-                                skip_comment();
-                                continue;
-                            case '>':
-                                ++p_;
-                                return {token{token_tag::minus_greater, line_no_}};
-                            default:
-                                return {token{token_tag::minus, line_no_}};
-                        }
+                        return {token{token_tag::minus_greater, line_no_}};
                     default:
-                        return std::nullopt;
+                        return {token{token_tag::minus, line_no_}};
                 }
-            // clang-format on
+            }
+        }
+
+
+        tl::expected<token, error_info> scan_number() noexcept {
+            bool is_floating_point = false;
+            char const* q = number_end(p_, is_floating_point);
+            if(q == nullptr)
+                return failed(error::invalid_number, line_no_);
+            std::swap(p_, q);
+            if(is_floating_point)
+                return convert_floating_point(q, p_);
+            else
+                return convert_integer(q, p_);
+        }
+
+
+        // end of a number starting with a digit at p or nullptr when it is malformed
+        static char const* number_end(char const* p, bool& is_floating_point) noexcept {
+            using character_runs::is_digit;
+            char const* q = character_runs::skip_digits(p + 1);
+            is_floating_point = false;
+            if(*q == '.') {
+                ++q;
+                if(!is_digit(*q))
+                    return nullptr;
+                q = character_runs::skip_digits(q + 1);
+                if(*q == '.')
+                    return nullptr;
+                is_floating_point = true;
+            }
+            if(*q == 'e' || *q == 'E') {
+                ++q;
+                if(*q == '+' || *q == '-')
+                    ++q;
+                if(!is_digit(*q))
+                    return nullptr;
+                q = character_runs::skip_digits(q + 1);
+                if(*q == '.' || *q == 'e' || *q == 'E')
+                    return nullptr;
+                is_floating_point = true;
+            }
+            return q;
         }
 
 
-        void skip_comment() noexcept {
+        tl::expected<token, error_info> scan_left_square_brace_or_vector() noexcept {
+            try {
+                auto const maybe_vector = scan_packed_vector();
+                if(maybe_vector)
+                    return *maybe_vector;
+            } catch(std::bad_alloc const&) {
+                return failed(error::not_enough_memory, line_no_);
+            }
             ++p_;
-            for(;;)
-                switch(*p_) {
-                case '\0':
-                    return;
-                case '\n':
-                    ++p_;
-                    return;
-                default:
-                    ++p_;
-                    continue;
-                }
+            return {token{token_tag::left_square_brace, line_no_}};
         }
 
 
-        tl::expected<token, error_info> scan_number() noexcept {
-            // clang-format off
-            char const* q = p_;
-            ++q;
-            bool has_point = false;
-            bool has_exponent = false;
-            for(;;)
-                switch(*q) {
-                    case '0': case '1': case '2': case '3': case '4':
-                    case '5': case '6': case '7': case '8': case '9':
-                        ++q;
-                        continue;
-                    case '.':
-                        if(has_point)
-                            return failed(error::invalid_number, line_no_);
-                        ++q;
-                        switch(*q) {
-                            case '0': case '1': case '2': case '3': case '4':
-                            case '5': case '6': case '7': case '8': case '9':
-                                has_point = true;
-                                continue;
-                            default:
-                                return failed(error::invalid_number, line_no_);
-                        }
-                        continue;
-                    case 'e': case 'E':
-                        if(has_exponent)
-                            return failed(error::invalid_number, line_no_);
-                        has_exponent = true;
-                        ++q;
-                        switch(*q) {
-                            case '+': case '-':
-                                ++q;
-                                continue;
-                            case '0': case '1': case '2': case '3': case '4':
-                            case '5': case '6': case '7': case '8': case '9':
-                                continue;
-                            default:
-                                return failed(error::invalid_number, line_no_);
-                        }
-                        continue;
-                    default:
-                        std::swap(p_, q);
-                        if(has_point || has_exponent)
-                            return convert_floating_point(q, p_);
-                        else
-                            return convert_integer(q, p_);
+        // vector of number literals only is converted straight into a packed buffer;
+        // anything else inside square braces, including malformed numbers, is left
+        // to the parser and scanned as separate tokens
+        std::optional<token> scan_packed_vector() {
+            char const* q = p_ + 1;
+            auto line_no = line_no_;
+            auto items = vector_reference{};
+            auto item_size = std::size_t(0);
+            bool is_floating_point_vector = false;
+            for(;;) {
+                q = character_runs::skip_spaces(q, line_no);
+                char const* from = q;
+                if(*q == '-')
+                    ++q;
+                if(!character_runs::is_digit(*q))
+                    return std::nullopt;
+                bool is_floating_point;
+                char const* until = number_end(q, is_floating_point);
+                if(until == nullptr)
+                    return std::nullopt;
+                if(items.get() == nullptr) {
+                    is_floating_point_vector = is_floating_point;
+                    item_size = is_floating_point ? sizeof(double) : sizeof(platform::integer);
+                    items = vector_reference{vector_buffer::allocate(initial_vector_capacity, item_size)};
+                } else if(is_floating_point != is_floating_point_vector) {
+                    return std::nullopt;
                 }
-            // clang-format on
+                auto* buffer = items.get();
+                if(buffer->size == buffer->capacity) {
+                    items = vector_reference{buffer->grow(buffer->capacity * 2, item_size)};
+                    buffer = items.get();
+                }
+                auto const converted = is_floating_point
+                        ? std::from_chars(from, until, buffer->items<double>()[buffer->size])
+                        : std::from_chars(from, until, buffer->items<platform::integer>()[buffer->size]);
+                if(converted.ec != std::errc{})
+                    return std::nullopt;
+                ++buffer->size;
+                q = character_runs::skip_spaces(until, line_no);
+                if(*q == ',') {
+                    ++q;
+                    continue;
+                }
+                if(*q != ']')
+                    return std::nullopt;
+                break;
+            }
+            auto const vector_line_no = line_no_;
+            p_ = q + 1;
+            line_no_ = line_no;
+            vector_buffer::retain(items.get());
+            return token{is_floating_point_vector ? token_tag::floating_point_vector : token_tag::integer_vector,
+                         items.get(), vector_line_no};
         }
 
 
@@ -298,81 +326,59 @@ namespace mandalang {
         }
 
 
-        tl::expected<token, error_info> scan_name() noexcept {
-            char const* q = p_;
-            ++q;
-            while(is_letter_or_digit(*q))
-                ++q;
+        tl::expected<token, error_info> scan_name_or_keyword() noexcept {
+            char const* q = character_runs::skip_letters_or_digits(p_ + 1);
             std::swap(p_, q);
-            return {token{std::string_view{q, std::size_t(p_ - q)}, line_no_}};
-        }
-
-
-        static bool is_letter_or_digit(char c) noexcept {
-            // clang-format off
-            switch(c) {
-                case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H': case 'I': case 'J':
-                case 'K': case 'L': case 'M': case 'N': case 'O': case 'P': case 'Q': case 'R': case 'S': case 'T':
-                case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z': case 'a': case 'b': case 'c': case 'd':
-                case 'e': case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': case 'l': case 'm': case 'n':
-                case 'o': case 'p': case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x':
-                case 'y': case 'z': case '_': case '0': case '1': case '2': case '3': case '4': case '5': case '6':
-                case '7': case '8': case '9':
-                    return true;
-                default:
-                    return false;
+            auto const text = std::string_view{q, std::size_t(p_ - q)};
+            auto const tag = keyword_tag(text);
+            if(tag)
+                return {token{*tag, line_no_}};
+            try {
+                return {token{names_->intern(text), line_no_}};
+            } catch(std::bad_alloc const&) {
+                return failed(error::not_enough_memory, line_no_);
             }
-            // clang-format on
-        }
-
-
-        bool try_scan_keyword(char c) noexcept {
-            if(p_[1] != c)
-                return false;
-            if(is_letter_or_digit(p_[2]))
-                return false;
-            p_ += 2;
-            return true;
-        }
-
-
-        bool try_scan_keyword(char c1, char c2) noexcept {
-            if(p_[1] != c1 || p_[2] != c2)
-                return false;
-            if(is_letter_or_digit(p_[3]))
-                return false;
-            p_ += 3;
-            return true;
-        }
-
-
-        bool try_scan_keyword(char c1, char c2, char c3) noexcept {
-            if(p_[1] != c1 || p_[2] != c2 || p_[3] != c3)
-                return false;
-            if(is_letter_or_digit(p_[4]))
-                return false;
-            p_ += 4;
-            return true;
         }
 
 
-        bool try_scan_keyword(char c1, char c2, char c3, char c4, char c5) noexcept {
-            if(p_[1] != c1 || p_[2] != c2 || p_[3] != c3 || p_[4] != c4 || p_[5] != c5)
-                return false;
-            if(is_letter_or_digit(p_[6]))
-                return false;
-            p_ += 6;
-            return true;
+        static bool is_name_start(char c) noexcept {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
         }
 
 
-        bool try_scan_keyword(char c1, char c2, char c3, char c4, char c5, char c6) noexcept {
-            if(p_[1] != c1 || p_[2] != c2 || p_[3] != c3 || p_[4] != c4 || p_[5] != c5 || p_[6] != c6)
-                return false;
-            if(is_letter_or_digit(p_[7]))
-                return false;
-            p_ += 7;
-            return true;
+        // (first + 14 * second + length) % 16 is a perfect hash over the keywords
+        static std::optional<token_tag> keyword_tag(std::string_view text) noexcept {
+            struct keyword {
+                std::string_view text;
+                token_tag tag;
+            };
+
+            static constexpr keyword keywords[16] = {
+                {"persistent", token_tag::keyword_persistent},
+                {"else", token_tag::keyword_else},
+                {"vector", token_tag::keyword_vector},
+                {"", token_tag::stop},
+                {"", token_tag::stop},
+                {"let", token_tag::keyword_let},
+                {"type", token_tag::keyword_type},
+                {"", token_tag::stop},
+                {"then", token_tag::keyword_then},
+                {"", token_tag::stop},
+                {"", token_tag::stop},
+                {"", token_tag::stop},
+                {"fn", token_tag::keyword_fn},
+                {"", token_tag::stop},
+                {"", token_tag::stop},
+                {"if", token_tag::keyword_if}
+            };
+
+            if(text.size() < 2 || text.size() > 10)
+                return std::nullopt;
+            auto const h = unsigned(text[0]) + 14u * unsigned(text[1]) + unsigned(text.size());
+            auto const& candidate = keywords[h % 16];
+            if(candidate.text != text)
+                return std::nullopt;
+            return candidate.tag;
         }
 
     }; // scanner
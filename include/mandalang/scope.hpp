@@ -1,7 +1,7 @@
 #pragma once
 
 
-#include <unordered_map>
+#include <vector>
 
 #include <nonstd/memory_pool.hpp>
 #include <tl/expected.hpp>
@@ -9,79 +9,119 @@
 #include <mandalang/ir.hpp>
 #include <mandalang/error_info.hpp>
 #include <mandalang/function.hpp>
+#include <mandalang/name_table.hpp>
 
 
 namespace mandalang {
 
 
     class scope {
-        scope* outer_;
-        std::unordered_map<std::string_view, symbol*> symbols_;
+
+        struct entry {
+            name_id id{no_name};
+            symbol* found{nullptr};
+        };
+
+        static constexpr auto initial_capacity = 8u;
+
+        scope const* outer_;
+        std::vector<entry> entries_;
+        std::size_t size_{0};
 
     public:
 
-        explicit scope(scope* outer = nullptr) noexcept: outer_{outer} { }
+        explicit scope(scope const* outer = nullptr) noexcept: outer_{outer} { }
 
 
         tl::expected<symbol const*, error_info> define(symbol* symbol) {
-            auto const name = symbol->name;
-            auto const result = symbols_.try_emplace(name, symbol);
-            if(!result.second)
-                return failed(error::duplicated_name, 0, result.first->first);
-            return result.first->second;
+            auto& entry = insert(symbol->name.id);
+            if(entry.found != nullptr)
+                return failed(error::duplicated_name, 0, entry.found->name.text);
+            entry.found = symbol;
+            return symbol;
         }
 
 
-        symbol const* redefine(std::string_view name, value const& value, nonstd::memory_pool<symbol>& symbols) {
-            auto const found = symbols_.find(name);
-            if(found == symbols_.end()) {
-                auto* created = symbols.create(name, value);
-                symbols_.try_emplace(name, created);
-                return created;
+        symbol const* redefine(identifier name, value const& value, nonstd::memory_pool<symbol>& symbols) {
+            auto& entry = insert(name.id);
+            if(entry.found == nullptr) {
+                entry.found = symbols.create(name, value);
             } else {
-                found->second->tag = symbol_tag::value;
-                found->second->value = value;
-                return found->second;
+                entry.found->redefine(value);
             }
+            return entry.found;
         }
 
 
-        symbol const* redefine(std::string_view name, type const& type, nonstd::memory_pool<symbol>& symbols) {
-            auto const found = symbols_.find(name);
-            if(found == symbols_.end()) {
-                auto* created = symbols.create(name, type);
-                symbols_.try_emplace(name, created);
-                return created;
+        symbol const* redefine(identifier name, type const& type, nonstd::memory_pool<symbol>& symbols) {
+            auto& entry = insert(name.id);
+            if(entry.found == nullptr) {
+                entry.found = symbols.create(name, type);
             } else {
-                found->second->tag = symbol_tag::type;
-                found->second->type = type;
-                return found->second;
+                entry.found->redefine(type);
             }
+            return entry.found;
         }
 
 
-        symbol const* find(std::string_view name) const noexcept {
-            auto const found = symbols_.find(name);
-            if(found == symbols_.end())
-                return outer_ ? outer_->find(name) : nullptr;
-            return found->second;
+        // reserves an entry of a name that is defined later, placeholder is an empty expression
+        symbol* declare(identifier name, nonstd::memory_pool<symbol>& symbols) {
+            auto& entry = insert(name.id);
+            if(entry.found == nullptr)
+                entry.found = symbols.create(name, symbol_tag::expression, nullptr);
+            return entry.found;
         }
 
-        symbol* find_local(std::string_view name) noexcept {
-            auto const found = symbols_.find(name);
-            if(found == symbols_.end())
-                return nullptr;
-            return found->second;
+
+        symbol const* find(name_id id) const noexcept {
+            for(auto const* each_scope = this; each_scope != nullptr; each_scope = each_scope->outer_) {
+                auto const* found = each_scope->lookup(id);
+                if(found)
+                    return found;
+            }
+            return nullptr;
+        }
+
+        symbol* find_local(name_id id) noexcept {
+            return lookup(id);
+        }
+
+
+        // room for entries of the size, so defining them does not rehash the table
+        void reserve(std::size_t size) {
+            auto capacity = entries_.empty() ? std::size_t(initial_capacity) : entries_.size();
+            while(capacity < size * 2)
+                capacity *= 2;
+            if(capacity == entries_.size())
+                return;
+            auto previous = std::move(entries_);
+            entries_.assign(capacity, entry{});
+            auto const mask = capacity - 1;
+            for(auto const& each_entry: previous) {
+                if(each_entry.id == no_name)
+                    continue;
+                auto i = hash(each_entry.id) & mask;
+                while(entries_[i].id != no_name)
+                    i = (i + 1) & mask;
+                entries_[i] = each_entry;
+            }
+        }
+
+
+        template<typename F> void for_each(F&& f) const {
+            for(auto const& each_entry: entries_)
+                if(each_entry.found != nullptr)
+                    f(*each_entry.found);
         }
 
 
 
-        tl::expected<void, error_info> import(scope const& other, std::vector<std::string_view> const& names) noexcept {
+        tl::expected<void, error_info> import(scope const& other, std::vector<identifier> const& names) {
             for(auto const& name: names) {
-                auto const found = other.symbols_.find(name);
-                if(found == other.symbols_.end())
-                    return failed(error::name_is_not_found_to_import, name);
-                auto const defined = define(found->second);
+                auto* found = other.lookup(name.id);
+                if(!found)
+                    return failed(error::name_is_not_found_to_import, name.text);
+                auto const defined = define(found);
                 if(!defined)
                     return tl::make_unexpected(defined.error());
             }
@@ -89,15 +129,65 @@ namespace mandalang {
         }
 
 
-        tl::expected<void, error_info> import(scope const& other) noexcept {
-            for(auto const& [name, symbol_ptr]: other.symbols_) {
-                auto const defined = define(symbol_ptr);
+        tl::expected<void, error_info> import(scope const& other) {
+            reserve(size_ + other.size_);
+            for(auto const& each_entry: other.entries_) {
+                if(each_entry.found == nullptr)
+                    continue;
+                auto const defined = define(each_entry.found);
                 if(!defined)
                     return tl::make_unexpected(defined.error());
             }
             return {};
         }
 
+    private:
+
+        static std::size_t hash(name_id id) noexcept {
+            return std::size_t(id) * 0x9e3779b97f4a7c15ull;
+        }
+
+
+        symbol* lookup(name_id id) const noexcept {
+            if(entries_.empty())
+                return nullptr;
+            auto const mask = entries_.size() - 1;
+            for(auto i = hash(id) & mask;; i = (i + 1) & mask) {
+                auto const& entry = entries_[i];
+                if(entry.id == id)
+                    return entry.found;
+                if(entry.id == no_name)
+                    return nullptr;
+            }
+        }
+
+
+        // returns existing entry for id or reserves an empty one, table is kept at most half full;
+        // existing entries are returned without growing, so redefinition never moves the table
+        entry& insert(name_id id) {
+            if(!entries_.empty()) {
+                auto const mask = entries_.size() - 1;
+                for(auto i = hash(id) & mask;; i = (i + 1) & mask) {
+                    auto& entry = entries_[i];
+                    if(entry.id == id)
+                        return entry;
+                    if(entry.id == no_name)
+                        break;
+                }
+            }
+            if((size_ + 1) * 2 > entries_.size())
+                reserve(size_ + 1);
+            auto const mask = entries_.size() - 1;
+            for(auto i = hash(id) & mask;; i = (i + 1) & mask) {
+                auto& entry = entries_[i];
+                if(entry.id == no_name) {
+                    entry.id = id;
+                    ++size_;
+                    return entry;
+                }
+            }
+        }
+
     }; // scope
 
 
@@ -0,0 +1,147 @@
+#pragma once
+
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MANDALANG_SHARED_SEGMENTS
+#endif
+
+#include <tl/expected.hpp>
+
+#include <mandalang/error_info.hpp>
+
+
+namespace mandalang {
+
+
+    // named POSIX shared memory published once and then mapped read-only by any
+    // number of processes; the first bytes are written last, so a reader that
+    // attaches while a segment is being filled sees an invalid image, not a torn one
+    class shared_segment {
+        static constexpr std::size_t published_mark_size = 8;
+
+        void const* data_{nullptr};
+        std::size_t size_{0};
+
+        shared_segment() noexcept = default;
+
+    public:
+
+        shared_segment(shared_segment const&) = delete;
+        shared_segment& operator = (shared_segment const&) = delete;
+
+        char const* data() const noexcept { return static_cast<char const*>(data_); }
+        std::size_t size() const noexcept { return size_; }
+
+
+#if defined(MANDALANG_SHARED_SEGMENTS)
+
+        ~shared_segment() {
+            if(data_ != nullptr)
+                ::munmap(const_cast<void*>(data_), size_);
+        }
+
+
+        // fails if a segment of the name exists already, remove it first to replace
+        static tl::expected<std::shared_ptr<shared_segment>, error_info> publish(std::string const& name,
+                                                                                 std::string_view bytes) {
+            if(bytes.size() < published_mark_size)
+                return failed(std::make_error_code(std::errc::invalid_argument));
+            auto const file = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+            if(file == -1)
+                return failed(std::error_code{errno, std::generic_category()});
+            if(::ftruncate(file, off_t(bytes.size())) == -1) {
+                auto const error_code = std::error_code{errno, std::generic_category()};
+                ::close(file);
+                ::shm_unlink(name.c_str());
+                return failed(error_code);
+            }
+            auto* memory = ::mmap(nullptr, bytes.size(), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+            ::close(file);
+            if(memory == MAP_FAILED) {
+                auto const error_code = std::error_code{errno, std::generic_category()};
+                ::shm_unlink(name.c_str());
+                return failed(error_code);
+            }
+            auto* target = static_cast<char*>(memory);
+            std::memcpy(target + published_mark_size, bytes.data() + published_mark_size,
+                        bytes.size() - published_mark_size);
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(target, bytes.data(), published_mark_size);
+            ::mprotect(memory, bytes.size(), PROT_READ);
+            auto segment = std::shared_ptr<shared_segment>{new shared_segment{}};
+            segment->data_ = memory;
+            segment->size_ = bytes.size();
+            return {std::move(segment)};
+        }
+
+
+        static tl::expected<std::shared_ptr<shared_segment>, error_info> attach(std::string const& name) {
+            auto const file = ::shm_open(name.c_str(), O_RDONLY, 0);
+            if(file == -1)
+                return failed(std::error_code{errno, std::generic_category()});
+            struct stat status;
+            if(::fstat(file, &status) == -1) {
+                auto const error_code = std::error_code{errno, std::generic_category()};
+                ::close(file);
+                return failed(error_code);
+            }
+            auto const size = std::size_t(status.st_size);
+            if(size == 0) {
+                ::close(file);
+                return failed(std::make_error_code(std::errc::invalid_argument));
+            }
+            auto* memory = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+            ::close(file);
+            if(memory == MAP_FAILED)
+                return failed(std::error_code{errno, std::generic_category()});
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto segment = std::shared_ptr<shared_segment>{new shared_segment{}};
+            segment->data_ = memory;
+            segment->size_ = size;
+            return {std::move(segment)};
+        }
+
+
+        // attached processes keep their mappings, the name becomes free for a new segment
+        static tl::expected<void, error_info> remove(std::string const& name) {
+            if(::shm_unlink(name.c_str()) == -1)
+                return failed(std::error_code{errno, std::generic_category()});
+            return {};
+        }
+
+#else
+
+        static tl::expected<std::shared_ptr<shared_segment>, error_info> publish(std::string const&,
+                                                                                 std::string_view) {
+            return failed(std::make_error_code(std::errc::not_supported));
+        }
+
+
+        static tl::expected<std::shared_ptr<shared_segment>, error_info> attach(std::string const&) {
+            return failed(std::make_error_code(std::errc::not_supported));
+        }
+
+
+        static tl::expected<void, error_info> remove(std::string const&) {
+            return failed(std::make_error_code(std::errc::not_supported));
+        }
+
+#endif
+
+    }; // shared_segment
+
+
+} // namespace mandalang
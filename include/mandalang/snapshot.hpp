@@ -0,0 +1,135 @@
+#pragma once
+
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+#include <mandalang/error_info.hpp>
+#include <mandalang/mod.hpp>
+#include <mandalang/module_image.hpp>
+#include <mandalang/source_mapping.hpp>
+#include <mandalang/vector_buffer.hpp>
+
+
+namespace mandalang {
+
+
+    // engine state as a sequence of named module images, loaded modules first
+    // and the default module last; the file is mapped and images are read in place
+    class snapshot {
+
+        static constexpr std::uint32_t format_version = 2;
+        static constexpr char magic[8] = {'M', 'L', 'S', 'N', 'A', 'P', '\0', '\0'};
+
+        struct header {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t front_end;
+            std::uint64_t entries_count;
+        };
+
+        struct entry_record {
+            std::uint64_t name_offset;
+            std::uint64_t name_size;
+            std::uint64_t image_offset;
+            std::uint64_t image_size;
+        };
+
+    public:
+
+        struct entry {
+            std::string_view name;
+            std::string_view image;
+        };
+
+    private:
+
+        std::shared_ptr<source_mapping const> mapping_;
+        front_end_mode front_end_{front_end_mode::single_pass};
+        std::vector<entry> entries_;
+
+        snapshot() noexcept = default;
+
+    public:
+
+        front_end_mode front_end() const noexcept { return front_end_; }
+        std::vector<entry> const& entries() const noexcept { return entries_; }
+        std::shared_ptr<void const> keeper() const noexcept { return mapping_; }
+
+
+        static tl::expected<void, error_info> save(std::string const& path, front_end_mode front_end,
+                                                   std::vector<entry> const& entries) {
+            auto bytes = std::string(sizeof(header) + entries.size() * sizeof(entry_record), '\0');
+            auto h = header{};
+            std::memcpy(h.magic, magic, sizeof(magic));
+            h.version = format_version;
+            h.front_end = std::uint32_t(front_end);
+            h.entries_count = entries.size();
+            std::memcpy(bytes.data(), &h, sizeof(h));
+            auto records = std::vector<entry_record>{};
+            records.reserve(entries.size());
+            for(auto const& each_entry: entries) {
+                auto const name_offset = bytes.size();
+                bytes.append(each_entry.name);
+                bytes.resize(aligned(bytes.size()), '\0');
+                auto const image_offset = bytes.size();
+                bytes.append(each_entry.image);
+                bytes.resize(aligned(bytes.size()), '\0');
+                records.push_back(entry_record{name_offset, each_entry.name.size(), image_offset, each_entry.image.size()});
+            }
+            std::memcpy(bytes.data() + sizeof(h), records.data(), records.size() * sizeof(entry_record));
+            return module_image::write_file(path, bytes);
+        }
+
+
+        static tl::expected<snapshot, error_info> open(std::string const& path) {
+            auto expected_mapping = source_mapping::open(path);
+            if(!expected_mapping)
+                return tl::make_unexpected(expected_mapping.error());
+            auto const* data = (*expected_mapping)->data();
+            auto const size = (*expected_mapping)->size();
+            auto h = header{};
+            if(size < sizeof(h))
+                return failed(error::invalid_snapshot);
+            std::memcpy(&h, data, sizeof(h));
+            if(std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != format_version
+               || h.entries_count == 0 || h.entries_count > (size - sizeof(h)) / sizeof(entry_record))
+                return failed(error::invalid_snapshot);
+            auto result = snapshot{};
+            result.front_end_ = front_end_mode(h.front_end);
+            result.entries_.reserve(h.entries_count);
+            auto const* record = reinterpret_cast<entry_record const*>(data + sizeof(h));
+            for(auto i = std::uint64_t(0); i != h.entries_count; ++i, ++record) {
+                if(!fits(record->name_offset, record->name_size, size)
+                   || !fits(record->image_offset, record->image_size, size))
+                    return failed(error::invalid_snapshot);
+                result.entries_.push_back(entry{
+                    std::string_view{data + record->name_offset, std::size_t(record->name_size)},
+                    std::string_view{data + record->image_offset, std::size_t(record->image_size)}});
+            }
+            result.mapping_ = std::move(*expected_mapping);
+            return {std::move(result)};
+        }
+
+    private:
+
+        // images start aligned as vector items in them are
+        static std::size_t aligned(std::size_t offset) noexcept {
+            return (offset + vector_buffer::alignment - 1) / vector_buffer::alignment * vector_buffer::alignment;
+        }
+
+
+        static bool fits(std::uint64_t offset, std::uint64_t length, std::size_t size) noexcept {
+            return offset <= size && length <= size - offset;
+        }
+
+    }; // snapshot
+
+
+} // namespace mandalang
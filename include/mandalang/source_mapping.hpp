@@ -0,0 +1,120 @@
+#pragma once
+
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MANDALANG_MAPPED_SOURCES
+#endif
+
+#include <tl/expected.hpp>
+
+#include <mandalang/character_runs.hpp>
+#include <mandalang/error_info.hpp>
+
+
+namespace mandalang {
+
+
+    // read-only contents of a source file followed by the zero padding scanner expects;
+    // the file is mapped over a zero filled anonymous reservation longer by the padding,
+    // so the padding comes from the reservation instead of a copy of the file
+    class source_mapping {
+        char const* data_{nullptr};
+        std::size_t size_{0};
+#if defined(MANDALANG_MAPPED_SOURCES)
+        std::size_t reserved_{0};
+#else
+        std::string contents_;
+#endif
+
+        source_mapping() noexcept = default;
+
+    public:
+
+        source_mapping(source_mapping const&) = delete;
+        source_mapping& operator = (source_mapping const&) = delete;
+
+        char const* data() const noexcept { return data_; }
+        std::size_t size() const noexcept { return size_; }
+
+
+#if defined(MANDALANG_MAPPED_SOURCES)
+
+        ~source_mapping() {
+            if(data_ != nullptr)
+                ::munmap(const_cast<char*>(data_), reserved_);
+        }
+
+
+        static tl::expected<std::unique_ptr<source_mapping>, error_info> open(std::string const& path) {
+            auto const file = ::open(path.c_str(), O_RDONLY);
+            if(file == -1)
+                return failed(std::error_code{errno, std::generic_category()});
+            auto mapped = map(file);
+            ::close(file);
+            return mapped;
+        }
+
+    private:
+
+        static tl::expected<std::unique_ptr<source_mapping>, error_info> map(int file) {
+            struct stat status;
+            if(::fstat(file, &status) == -1)
+                return failed(std::error_code{errno, std::generic_category()});
+            auto const page_size = std::size_t(::sysconf(_SC_PAGESIZE));
+            auto const size = std::size_t(status.st_size);
+            auto const reserved = (size + character_runs::padding + page_size - 1) / page_size * page_size;
+            auto* reservation = ::mmap(nullptr, reserved, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(reservation == MAP_FAILED)
+                return failed(std::error_code{errno, std::generic_category()});
+            auto mapping = std::unique_ptr<source_mapping>{new source_mapping{}};
+            mapping->data_ = static_cast<char const*>(reservation);
+            mapping->size_ = size;
+            mapping->reserved_ = reserved;
+            if(size == 0)
+                return {std::move(mapping)};
+            auto* contents = ::mmap(reservation, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, file, 0);
+            if(contents == MAP_FAILED)
+                return failed(std::error_code{errno, std::generic_category()});
+            ::madvise(contents, size, MADV_SEQUENTIAL);
+            return {std::move(mapping)};
+        }
+
+#else
+
+        static tl::expected<std::unique_ptr<source_mapping>, error_info> open(std::string const& path) {
+            auto file = std::unique_ptr<FILE, int (*)(FILE*)>{std::fopen(path.c_str(), "rb"), std::fclose};
+            if(!file)
+                return failed(std::error_code{errno, std::generic_category()});
+            auto mapping = std::unique_ptr<source_mapping>{new source_mapping{}};
+            char chunk[4096];
+            for(;;) {
+                auto const bytes_read = std::fread(chunk, 1, sizeof(chunk), file.get());
+                mapping->contents_.append(chunk, bytes_read);
+                if(bytes_read != sizeof(chunk))
+                    break;
+            }
+            if(std::ferror(file.get()))
+                return failed(std::error_code{errno, std::generic_category()});
+            mapping->size_ = mapping->contents_.size();
+            mapping->contents_.append(character_runs::padding, '\0');
+            mapping->data_ = mapping->contents_.data();
+            return {std::move(mapping)};
+        }
+
+#endif
+
+    }; // source_mapping
+
+
+} // namespace mandalang
@@ -0,0 +1,131 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace mandalang {
+
+
+    // fixed set of worker threads running submitted tasks, tasks may submit more tasks
+    class thread_pool {
+        std::mutex mutex_;
+        std::condition_variable task_submitted_;
+        std::condition_variable idle_;
+        std::deque<std::function<void()>> tasks_;
+        std::size_t running_{0};
+        bool stopping_{false};
+        std::vector<std::thread> threads_;
+
+    public:
+
+        explicit thread_pool(unsigned threads_count = std::thread::hardware_concurrency()) {
+            if(threads_count == 0)
+                threads_count = 1;
+            threads_.reserve(threads_count);
+            for(auto i = 0u; i != threads_count; ++i)
+                threads_.emplace_back([this] { work(); });
+        }
+
+        thread_pool(thread_pool const&) = delete;
+        thread_pool& operator = (thread_pool const&) = delete;
+
+        ~thread_pool() {
+            {
+                auto const lock = std::lock_guard{mutex_};
+                stopping_ = true;
+            }
+            task_submitted_.notify_all();
+            for(auto& each_thread: threads_)
+                each_thread.join();
+        }
+
+
+        std::size_t size() const noexcept { return threads_.size(); }
+
+
+        void submit(std::function<void()> task) {
+            {
+                auto const lock = std::lock_guard{mutex_};
+                tasks_.push_back(std::move(task));
+            }
+            task_submitted_.notify_one();
+        }
+
+
+        // blocks until all submitted tasks and tasks submitted by them are done
+        void wait() {
+            auto lock = std::unique_lock{mutex_};
+            idle_.wait(lock, [this] { return tasks_.empty() && running_ == 0; });
+        }
+
+
+        // runs task(i) for each i below count on workers and the calling thread, returns when
+        // all of them are done; the caller claims parts too, so tasks may fork again without
+        // waiting for workers busy with their parents; tasks should not throw
+        void fork_join(std::size_t count, std::function<void(std::size_t)> const& task) {
+            struct batch {
+                std::atomic<std::size_t> next{0};
+                std::atomic<std::size_t> done{0};
+                std::mutex mutex;
+                std::condition_variable finished;
+            };
+            auto shared = std::make_shared<batch>();
+            // helpers which start late find nothing left to claim and never touch the task
+            auto const run = [shared, count, &task] {
+                for(auto i = shared->next.fetch_add(1); i < count; i = shared->next.fetch_add(1)) {
+                    task(i);
+                    if(shared->done.fetch_add(1) + 1 == count) {
+                        { auto const lock = std::lock_guard{shared->mutex}; }
+                        shared->finished.notify_all();
+                    }
+                }
+            };
+            auto const helpers = std::min(count, threads_.size() + 1) - 1;
+            for(auto i = std::size_t(0); i != helpers; ++i)
+                submit(run);
+            run();
+            auto lock = std::unique_lock{shared->mutex};
+            shared->finished.wait(lock, [&] { return shared->done.load() == count; });
+        }
+
+
+        // workers for data parallel builtins, started on first use
+        static thread_pool& shared() {
+            static thread_pool pool;
+            return pool;
+        }
+
+    private:
+
+        void work() {
+            auto lock = std::unique_lock{mutex_};
+            for(;;) {
+                task_submitted_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if(tasks_.empty())
+                    return;
+                auto task = std::move(tasks_.front());
+                tasks_.pop_front();
+                ++running_;
+                lock.unlock();
+                task();
+                lock.lock();
+                --running_;
+                if(tasks_.empty() && running_ == 0)
+                    idle_.notify_all();
+            }
+        }
+
+    }; // thread_pool
+
+
+} // namespace mandalang
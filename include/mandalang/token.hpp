@@ -1,19 +1,22 @@
 #pragma once
 
+#include <cstdint>
 #include <string_view>
 
 #include <configure.hpp>
+#include <mandalang/name_table.hpp>
+#include <mandalang/vector_buffer.hpp>
 
 
 namespace mandalang {
 
-    enum class token_tag {
-        floating_point, integer, name,
+    enum class token_tag : std::uint8_t {
+        floating_point, integer, name, floating_point_vector, integer_vector,
         plus, minus, asterisk, slash, left_parenthesis, right_parenthesis, left_square_brace, right_square_brace, minus_greater, comma,
         equals, double_equals, exclamation_equals, greater, less, greater_equals, less_equals,
         double_ampersand, double_vertical, exclamation,
         keyword_fn, keyword_let, keyword_type, keyword_if, keyword_then, keyword_else,
-        keyword_vector,
+        keyword_vector, keyword_persistent,
         stop
     }; // token_tag
 
@@ -23,7 +26,8 @@ namespace mandalang {
         union {
             double floating_point;
             platform::integer integer;
-            std::string_view name;
+            identifier name;
+            vector_buffer* vector;
         };
 
         token() noexcept { }
@@ -37,9 +41,13 @@ namespace mandalang {
         token(platform::integer integer, unsigned line_no) noexcept:
             tag{token_tag::integer}, line_no{line_no}, integer{integer} { }
 
-        token(std::string_view name, unsigned line_no) noexcept:
+        token(identifier name, unsigned line_no) noexcept:
             tag{token_tag::name}, name{name}, line_no{line_no} { }
 
+        // scanned vector token holds one reference to the buffer until token_buffer adopts it
+        token(token_tag tag, vector_buffer* vector, unsigned line_no) noexcept:
+            tag{tag}, line_no{line_no}, vector{vector} { }
+
     };
 
 } // namespace mandalang
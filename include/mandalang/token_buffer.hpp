@@ -0,0 +1,139 @@
+#pragma once
+
+
+#include <cstddef>
+#include <vector>
+
+#include <tl/expected.hpp>
+
+#include <configure.hpp>
+#include <mandalang/error_info.hpp>
+#include <mandalang/name_table.hpp>
+#include <mandalang/scanner.hpp>
+#include <mandalang/token.hpp>
+#include <mandalang/vector_buffer.hpp>
+
+
+namespace mandalang {
+
+
+    // all tokens of a source kept as separate arrays of tags, lines and literal payloads;
+    // scanning stops at the first invalid token, the error is reported when parser reaches it
+    class token_buffer {
+
+        union payload {
+            double floating_point;
+            platform::integer integer;
+            name_id name;
+            vector_buffer* vector;
+        };
+
+        name_table* names_{nullptr};
+        std::vector<token_tag> tags_;
+        std::vector<unsigned> lines_;
+        std::vector<payload> payloads_;
+        std::vector<vector_reference> vectors_;
+        tl::optional<error_info> error_;
+
+    public:
+
+        using size_type = std::size_t;
+
+        token_buffer() noexcept = default;
+
+        static token_buffer tokenize(char const* source, name_table& names) {
+            return tokenize(source, nullptr, 1, 0, names);
+        }
+
+
+        // tokens of a span of a larger source, stop follows the token reaching the end and
+        // is on the line of the token after the span, where the whole source would stop parsing
+        static token_buffer tokenize(char const* source, char const* end, unsigned line_no, unsigned end_line_no,
+                                     name_table& names) {
+            token_buffer buffer;
+            buffer.names_ = &names;
+            scanner scanner{source, names, line_no};
+            for(;;) {
+                auto const expected_token = scanner.next();
+                if(!expected_token) {
+                    buffer.error_ = expected_token.error();
+                    return buffer;
+                }
+                buffer.push_back(*expected_token);
+                if(expected_token->tag == token_tag::stop)
+                    return buffer;
+                if(end != nullptr && scanner.position() >= end) {
+                    buffer.push_back(token{token_tag::stop, end_line_no});
+                    return buffer;
+                }
+            }
+        }
+
+        size_type size() const noexcept { return tags_.size(); }
+
+        token_tag tag(size_type i) const noexcept {
+            if(i < tags_.size())
+                return tags_[i];
+            return error_ ? token_tag::stop : tags_.back();
+        }
+
+        unsigned line_no(size_type i) const noexcept {
+            if(i < lines_.size())
+                return lines_[i];
+            return error_ ? error_->line : lines_.back();
+        }
+
+
+        // past the end tokens repeat stop, or the scanning error when there was one
+        tl::expected<token, error_info> at(size_type i) const noexcept {
+            if(i >= tags_.size()) {
+                if(error_)
+                    return tl::make_unexpected(*error_);
+                i = tags_.size() - 1;
+            }
+            switch(tags_[i]) {
+                case token_tag::floating_point:
+                    return {token{payloads_[i].floating_point, lines_[i]}};
+                case token_tag::integer:
+                    return {token{payloads_[i].integer, lines_[i]}};
+                case token_tag::name:
+                    return {token{identifier{payloads_[i].name, names_->text(payloads_[i].name)}, lines_[i]}};
+                case token_tag::floating_point_vector:
+                case token_tag::integer_vector:
+                    return {token{tags_[i], payloads_[i].vector, lines_[i]}};
+                default:
+                    return {token{tags_[i], lines_[i]}};
+            }
+        }
+
+    private:
+
+        void push_back(token const& t) {
+            tags_.push_back(t.tag);
+            lines_.push_back(t.line_no);
+            auto& p = payloads_.emplace_back();
+            switch(t.tag) {
+                case token_tag::floating_point:
+                    p.floating_point = t.floating_point;
+                    return;
+                case token_tag::integer:
+                    p.integer = t.integer;
+                    return;
+                case token_tag::name:
+                    p.name = t.name.id;
+                    return;
+                case token_tag::floating_point_vector:
+                case token_tag::integer_vector:
+                    p.vector = t.vector;
+                    vectors_.emplace_back(t.vector);
+                    return;
+                default:
+                    p.integer = 0;
+                    return;
+            }
+        }
+
+    }; // token_buffer
+
+
+} // namespace mandalang
@@ -4,8 +4,9 @@
 namespace mandalang {
 
 
+    // intrinsic is the type of higher-order builtins, which are typed at each call
     enum class type_tag {
-        floating_point, integer, boolean, composite
+        floating_point, integer, boolean, composite, intrinsic
     }; // type_tag
 
 
@@ -16,11 +17,14 @@ namespace mandalang {
 
         bool operator == (type const& other) const noexcept;
         bool operator != (type const& other) const noexcept;
+        bool is_vector() const noexcept;
+        bool is_persistent() const noexcept;
+        bool is_function() const noexcept;
     };
 
 
     enum class composite_type_tag {
-        function, vector
+        function, vector, persistent
     };
 
 
@@ -76,6 +80,7 @@ namespace mandalang {
                 case composite_type_tag::function:
                     return function == other.function;
                 case composite_type_tag::vector:
+                case composite_type_tag::persistent:
                     return item == other.item;
                 default:
                     return true;
@@ -89,8 +94,9 @@ namespace mandalang {
     }; // type
 
 
+    // composite types are interned by type_table, so equal types share the same composite
     inline bool type::operator == (type const& other) const noexcept {
-        return tag == type_tag::composite ? *composite == *other.composite : tag == other.tag;
+        return tag == other.tag && composite == other.composite;
     }
 
 
@@ -99,6 +105,21 @@ namespace mandalang {
     }
 
 
+    inline bool type::is_vector() const noexcept {
+        return tag == type_tag::composite && composite->tag == composite_type_tag::vector;
+    }
+
+
+    inline bool type::is_persistent() const noexcept {
+        return tag == type_tag::composite && composite->tag == composite_type_tag::persistent;
+    }
+
+
+    inline bool type::is_function() const noexcept {
+        return tag == type_tag::composite && composite->tag == composite_type_tag::function;
+    }
+
+
     template<typename S> S& operator << (S& stream, type const& type);
 
     template<typename S> S& operator << (S& stream, composite_type const& composite_type) {
@@ -114,6 +135,10 @@ namespace mandalang {
                 return stream;
             case composite_type_tag::vector:
                 stream << "vector[" << composite_type.item << ']';
+                return stream;
+            case composite_type_tag::persistent:
+                stream << "persistent[" << composite_type.item << ']';
+                return stream;
             default:
                 return stream << "unknown";
         }
@@ -130,6 +155,8 @@ namespace mandalang {
                 return stream << "boolean";
             case type_tag::composite:
                 return stream << *type.composite;
+            case type_tag::intrinsic:
+                return stream << "intrinsic";
             default:
                 return stream << "unknown";
         }
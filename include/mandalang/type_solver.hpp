@@ -6,20 +6,22 @@
 
 #include <mandalang/ir.hpp>
 #include <mandalang/error_info.hpp>
+#include <mandalang/last_use.hpp>
 #include <mandalang/type.hpp>
+#include <mandalang/type_table.hpp>
 
 
 namespace mandalang {
 
 
     class type_solver {
-        nonstd::memory_pool<composite_type>& composite_types_;
+        type_table& types_;
         nonstd::memory_pool<symbol>& symbols_;
     public:
 
-        type_solver(nonstd::memory_pool<composite_type>& composite_types,
+        type_solver(type_table& types,
                     nonstd::memory_pool<symbol>& symbols) noexcept:
-            composite_types_{composite_types}, symbols_{symbols} { }
+            types_{types}, symbols_{symbols} { }
 
 
         tl::expected<void, error_info> solve(ast_node* node) noexcept {
@@ -30,8 +32,24 @@ namespace mandalang {
                 case ast_node_tag::integer:
                     node->type = type{type_tag::integer};
                     return {};
+                case ast_node_tag::floating_point_vector:
+                    node->type = types_.vector(type{type_tag::floating_point});
+                    return {};
+                case ast_node_tag::integer_vector:
+                    node->type = types_.vector(type{type_tag::integer});
+                    return {};
+                case ast_node_tag::vector_literal:
+                    return solve_vector_literal(node);
                 case ast_node_tag::resolved_name:
                     return solve_name(node);
+                case ast_node_tag::local_slot:
+                case ast_node_tag::last_local_slot:
+                case ast_node_tag::environment_slot:
+                    node->type = node->slot.source->function_parameter.type;
+                    return {};
+                case ast_node_tag::global_slot:
+                    node->type = node->slot.global->type;
+                    return {};
                 case ast_node_tag::subexpression:
                     return solve_subexpression(node);
                 case ast_node_tag::negate:
@@ -67,11 +85,98 @@ namespace mandalang {
                     return solve_function_call(node);
                 case ast_node_tag::conditional:
                     return solve_conditional(node);
+                case ast_node_tag::type_function:
+                case ast_node_tag::type_vector:
+                case ast_node_tag::type_persistent:
+                    return solve_type(node);
                 default:
                     return failed(error::invalid_ast_node_to_solve_type, node->line_no);
             }
         }
 
+
+        // types a single node whose operands are solved already, used by single pass parsing
+        tl::expected<void, error_info> solve_node(ast_node* node) noexcept {
+            switch(node->tag) {
+                case ast_node_tag::floating_point:
+                case ast_node_tag::integer:
+                case ast_node_tag::floating_point_vector:
+                case ast_node_tag::integer_vector:
+                case ast_node_tag::resolved_name:
+                case ast_node_tag::local_slot:
+                case ast_node_tag::last_local_slot:
+                case ast_node_tag::environment_slot:
+                case ast_node_tag::global_slot:
+                    return solve(node);
+                case ast_node_tag::subexpression:
+                    node->type = node->unary->type;
+                    return {};
+                case ast_node_tag::vector_literal:
+                    return type_vector_literal(node);
+                case ast_node_tag::negate:
+                    return type_negate(node);
+                case ast_node_tag::boolean_not:
+                    return type_boolean_not(node);
+                case ast_node_tag::multiply:
+                    return type_generic_multiply(node);
+                case ast_node_tag::divide:
+                    return type_generic_divide(node);
+                case ast_node_tag::add:
+                    return type_generic_add(node);
+                case ast_node_tag::subtract:
+                    return type_generic_subtract(node);
+                case ast_node_tag::boolean_or:
+                case ast_node_tag::boolean_and:
+                    return type_boolean_binary(node);
+                case ast_node_tag::equals_to:
+                    return type_generic_equals_to(node);
+                case ast_node_tag::not_equals_to:
+                    return type_generic_not_equals_to(node);
+                case ast_node_tag::greater_than:
+                    return type_generic_greater_than(node);
+                case ast_node_tag::greater_or_equals:
+                    return type_generic_greater_or_equals(node);
+                case ast_node_tag::less_than:
+                    return type_generic_less_than(node);
+                case ast_node_tag::less_or_equals:
+                    return type_generic_less_or_equals(node);
+                case ast_node_tag::resolved_function:
+                    return type_function(node);
+                case ast_node_tag::resolved_function_call:
+                    return type_function_call(node);
+                case ast_node_tag::conditional:
+                    return type_conditional(node);
+                default:
+                    return failed(error::invalid_ast_node_to_solve_type, node->line_no);
+            }
+        }
+
+
+        // types parameters, result and self of a function before its body is solved
+        tl::expected<void, error_info> solve_function_header(ast_node* node) noexcept {
+            auto solved = solve_type(node->function.result);
+            if(!solved)
+                return solved;
+            auto i = 0u;
+            type parameters[composite_type::max_function_parameters];
+            for(auto* current_node = node->function.parameters; current_node != nullptr; current_node = current_node->typed_name.next) {
+                solved = solve_type(current_node->typed_name.type);
+                if(!solved)
+                    return solved;
+                auto* parameter_symbol = node->function.scope->find_local(current_node->typed_name.name.id);
+                if(!parameter_symbol)
+                    return failed(error::invalid_type_resolving, node->line_no, current_node->typed_name.name.text);
+                parameter_symbol->function_parameter.type = current_node->typed_name.type->type;
+                parameters[i++] = current_node->typed_name.type->type;
+            }
+            node->type = types_.function(node->function.result->type, i, parameters);
+            auto* self = node->function.scope->find_local(self_name.id);
+            if(!self)
+                return failed(error::invalid_type_resolving, node->line_no);
+            self->value.type = node->type;
+            return {};
+        }
+
     private:
 
         tl::expected<void, error_info> solve_name(ast_node* node) noexcept {
@@ -88,6 +193,9 @@ namespace mandalang {
                 case symbol_tag::fn_parameter:
                     node->type = node->resolved_name->function_parameter.type;
                     return {};
+                case symbol_tag::intrinsic:
+                    node->type = type{type_tag::intrinsic};
+                    return {};
                 default:
                     return failed(error::invalid_type_resolving, node->line_no);
             }
@@ -104,10 +212,45 @@ namespace mandalang {
         }
 
 
+        tl::expected<void, error_info> solve_vector_literal(ast_node* node) noexcept {
+            for(auto* item = node->vector_literal.items; item != nullptr; item = item->binary.right) {
+                auto const solved = solve(item->binary.left);
+                if(!solved)
+                    return solved;
+            }
+            return type_vector_literal(node);
+        }
+
+
+        tl::expected<void, error_info> type_vector_literal(ast_node* node) noexcept {
+            auto const item_type = node->vector_literal.items->binary.left->type;
+            if(item_type.tag == type_tag::composite)
+                return failed(error::vector_items_should_be_numerical, node->line_no);
+            for(auto* item = node->vector_literal.items; item != nullptr; item = item->binary.right)
+                if(item->binary.left->type != item_type)
+                    return failed(error::vector_items_should_have_same_type, item->line_no);
+            node->type = types_.vector(item_type);
+            return {};
+        }
+
+
+        tl::expected<void, error_info> solve_operands(ast_node* node) noexcept {
+            auto const solved = solve(node->binary.left);
+            if(!solved)
+                return solved;
+            return solve(node->binary.right);
+        }
+
+
         tl::expected<void, error_info> solve_negate(ast_node* node) noexcept {
             auto const solved = solve(node->unary);
             if(!solved)
                 return solved;
+            return type_negate(node);
+        }
+
+
+        tl::expected<void, error_info> type_negate(ast_node* node) noexcept {
             switch (node->unary->type.tag) {
                 case type_tag::floating_point:
                     node->tag = ast_node_tag::floating_point_negate;
@@ -127,6 +270,11 @@ namespace mandalang {
             auto const solved = solve(node->unary);
             if(!solved)
                 return solved;
+            return type_boolean_not(node);
+        }
+
+
+        tl::expected<void, error_info> type_boolean_not(ast_node* node) noexcept {
             if(node->unary->type.tag != type_tag::boolean)
                 return failed(error::boolean_not_should_have_boolean_operand, node->line_no);
             node->type.tag = type_tag::boolean;
@@ -134,13 +282,45 @@ namespace mandalang {
         }
 
 
+        // element-wise operations apply to vectors of the same numerical items
+        tl::expected<void, error_info> type_vector_arithmetic(ast_node* node, ast_node_tag floating_point_tag,
+                                                              ast_node_tag integer_tag) noexcept {
+            if(!node->binary.left->type.is_vector())
+                return failed(error::operands_should_have_numerical_types, node->line_no);
+            switch(node->binary.left->type.composite->item.tag) {
+                case type_tag::floating_point:
+                    node->tag = floating_point_tag;
+                    break;
+                case type_tag::integer:
+                    node->tag = integer_tag;
+                    break;
+                default:
+                    return failed(error::operands_should_have_numerical_types, node->line_no);
+            }
+            node->type = node->binary.left->type;
+            return {};
+        }
+
+
+        tl::expected<void, error_info> type_vector_comparison(ast_node* node, ast_node_tag floating_point_tag,
+                                                              ast_node_tag integer_tag) noexcept {
+            auto const typed = type_vector_arithmetic(node, floating_point_tag, integer_tag);
+            if(!typed)
+                return typed;
+            node->type = types_.vector(type{type_tag::boolean});
+            return {};
+        }
+
+
         tl::expected<void, error_info> solve_generic_multiply(ast_node* node) noexcept {
-            auto const left_solved = solve(node->binary.left);
-            if(!left_solved)
-                return left_solved;
-            auto const right_solved = solve(node->binary.right);
-            if(!right_solved)
-                return right_solved;
+            auto const solved = solve_operands(node);
+            if(!solved)
+                return solved;
+            return type_generic_multiply(node);
+        }
+
+
+        tl::expected<void, error_info> type_generic_multiply(ast_node* node) noexcept {
             if(node->binary.left->type != node->binary.right->type)
                 return failed(error::operands_should_have_same_type, node->line_no);
             switch (node->binary.left->type.tag) {
@@ -152,6 +332,9 @@ namespace mandalang {
                     node->tag = ast_node_tag::integer_multiply;
                     node->type = type{type_tag::integer};
                     return {};
+                case type_tag::composite:
+                    return type_vector_arithmetic(node, ast_node_tag::floating_point_vector_multiply,
+                                                  ast_node_tag::integer_vector_multiply);
                 default:
                     return failed(error::operands_should_have_numerical_types, node->line_no);
             }
@@ -159,12 +342,14 @@ namespace mandalang {
 
 
         tl::expected<void, error_info> solve_generic_divide(ast_node* node) noexcept {
-            auto const left_solved = solve(node->binary.left);
-            if(!left_solved)
-                return left_solved;
-            auto const right_solved = solve(node->binary.right);
-            if(!right_solved)
-                return right_solved;
+            auto const solved = solve_operands(node);
+            if(!solved)
+                return solved;
+            return type_generic_divide(node);
+        }
+
+
+        tl::expected<void, error_info> type_generic_divide(ast_node* node) noexcept {
             if(node->binary.left->type != node->binary.right->type)
                 return failed(error::operands_should_have_same_type, node->line_no);
             switch (node->binary.left->type.tag) {
@@ -176,6 +361,9 @@ namespace mandalang {
                     node->tag = ast_node_tag::integer_divide;
                     node->type = type{type_tag::integer};
                     return {};
+                case type_tag::composite:
+                    return type_vector_arithmetic(node, ast_node_tag::floating_point_vector_divide,
+                                                  ast_node_tag::integer_vector_divide);
                 default:
                     return failed(error::operands_should_have_numerical_types, node->line_no);
             }
@@ -183,12 +371,14 @@ namespace mandalang {
 
 
         tl::expected<void, error_info> solve_generic_add(ast_node* node) noexcept {
-            auto const left_solved = solve(node->binary.left);
-            if(!left_solved)
-                return left_solved;
-            auto const right_solved = solve(node->binary.right);
-            if(!right_solved)
-                return right_solved;
+            auto const solved = solve_operands(node);
+            if(!solved)
+                return solved;
+            return type_generic_add(node);
+        }
+
+
+        tl::expected<void, error_info> type_generic_add(ast_node* node) noexcept {
             if(node->binary.left->type != node->binary.right->type)
                 return failed(error::operands_should_have_same_type, node->line_no);
             switch (node->binary.left->type.tag) {
@@ -200,6 +390,9 @@ namespace mandalang {
                     node->tag = ast_node_tag::integer_add;
                     node->type = type{type_tag::integer};
                     return {};
+                case type_tag::composite:
+                    return type_vector_arithmetic(node, ast_node_tag::floating_point_vector_add,
+                                                  ast_node_tag::integer_vector_add);
                 default:
                     return failed(error::operands_should_have_numerical_types, node->line_no);
             }
@@ -207,12 +400,14 @@ namespace mandalang {
 
 
         tl::expected<void, error_info> solve_generic_subtract(ast_node* node) noexcept {
-            auto const left_solved = solve(node->binary.left);
-            if(!left_solved)
-                return left_solved;
-            auto const right_solved = solve(node->binary.right);
-            if(!right_solved)
-                return right_solved;
+            auto const solved = solve_operands(node);
+            if(!solved)
+                return solved;
+            return type_generic_subtract(node);
+        }
+
+
+        tl::expected<void, error_info> type_generic_subtract(ast_node* node) noexcept {
             if(node->binary.left->type != node->binary.right->type)
                 return failed(error::operands_should_have_same_type, node->line_no);
             switch (node->binary.left->type.tag) {
@@ -224,6 +419,9 @@ namespace mandalang {
                     node->tag = ast_node_tag::integer_subtract;
                     node->type = type{type_tag::integer};
                     return {};
+                case type_tag::composite:
+                    return type_vector_arithmetic(node, ast_node_tag::floating_point_vector_subtract,
+                                                  ast_node_tag::integer_vector_subtract);
                 default:
                     return failed(error::operands_should_have_numerical_types, node->line_no);
             }
@@ -231,12 +429,14 @@ namespace mandalang {
 
 
         tl::expected<void, error_info> solve_boolean_binary(ast_node* node) noexcept {
-            auto const left_solved = solve(node->binary.left);
-            if(!left_solved)
-                return left_solved;
-            auto const right_solved = solve(node->binary.right);
-            if(!right_solved)
-                return right_solved;
+            auto const solved = solve_operands(node);
+            if(!solved)
+                return solved;
+            return type_boolean_binary(node);
+        }
+
+
+        tl::expected<void, error_info> type_boolean_binary(ast_node* node) noexcept {
             if(node->binary.left->type.tag != type_tag::boolean || node->binary.left->type.tag != type_tag::boolean)
                 return failed(error::operands_should_have_boolean_type, node->line_no);
             node->type.tag = type_tag::boolean;
@@ -245,12 +445,14 @@ namespace mandalang {
 
 
         tl::expected<void, error_info> solve_generic_equals_to(ast_node* node) noexcept {
-            auto const left_solved = solve(node->binary.left);
-            if(!left_solved)
-                return left_solved;
-            auto const right_solved = solve(node->binary.right);
-            if(!right_solved)
-                return right_solved;
+            auto const solved = solve_operands(node);
+            if(!solved)
+                return solved;
+            return type_generic_equals_to(node);
+        }
+
+
+        tl::expected<void, error_info> type_generic_equals_to(ast_node* node) noexcept {
             if(node->binary.left->type != node->binary.right->type)
                 return failed(error::operands_should_have_same_type, node->line_no);
             switch (node->binary.left->type.tag) {
@@ -266,6 +468,9 @@ namespace mandalang {
                     node->tag = ast_node_tag::boolean_equals_to;
                     node->type = type{type_tag::boolean};
                     return {};
+                case type_tag::composite:
+                    return type_vector_comparison(node, ast_node_tag::floating_point_vector_equals_to,
+                                                  ast_node_tag::integer_vector_equals_to);
                 default:
                     return failed(error::operands_should_have_numerical_types, node->line_no);
             }
@@ -273,12 +478,14 @@ namespace mandalang {
 
 
         tl::expected<void, error_info> solve_generic_not_equals_to(ast_node* node) noexcept {
-            auto const left_solved = solve(node->binary.left);
-            if(!left_solved)
-                return left_solved;
-            auto const right_solved = solve(node->binary.right);
-            if(!right_solved)
-                return right_solved;
+            auto const solved = solve_operands(node);
+            if(!solved)
+                return solved;
+            return type_generic_not_equals_to(node);
+        }
+
+
+        tl::expected<void, error_info> type_generic_not_equals_to(ast_node* node) noexcept {
             if(node->binary.left->type != node->binary.right->type)
                 return failed(error::operands_should_have_same_type, node->line_no);
             switch (node->binary.left->type.tag) {
@@ -294,6 +501,9 @@ namespace mandalang {
                     node->tag = ast_node_tag::boolean_not_equals_to;
                     node->type = type{type_tag::boolean};
                     return {};
+                case type_tag::composite:
+                    return type_vector_comparison(node, ast_node_tag::floating_point_vector_not_equals_to,
+                                                  ast_node_tag::integer_vector_not_equals_to);
                 default:
                     return failed(error::operands_should_have_numerical_types, node->line_no);
             }
@@ -301,12 +511,14 @@ namespace mandalang {
 
 
         tl::expected<void, error_info> solve_generic_greater_than(ast_node* node) noexcept {
-            auto const left_solved = solve(node->binary.left);
-            if(!left_solved)
-                return left_solved;
-            auto const right_solved = solve(node->binary.right);
-            if(!right_solved)
-                return right_solved;
+            auto const solved = solve_operands(node);
+            if(!solved)
+                return solved;
+            return type_generic_greater_than(node);
+        }
+
+
+        tl::expected<void, error_info> type_generic_greater_than(ast_node* node) noexcept {
             if(node->binary.left->type != node->binary.right->type)
                 return failed(error::operands_should_have_same_type, node->line_no);
             switch (node->binary.left->type.tag) {
@@ -318,6 +530,9 @@ namespace mandalang {
                     node->tag = ast_node_tag::integer_greater_than;
                     node->type = type{type_tag::boolean};
                     return {};
+                case type_tag::composite:
+                    return type_vector_comparison(node, ast_node_tag::floating_point_vector_greater_than,
+                                                  ast_node_tag::integer_vector_greater_than);
                 default:
                     return failed(error::operands_should_have_numerical_types, node->line_no);
             }
@@ -325,12 +540,14 @@ namespace mandalang {
 
 
         tl::expected<void, error_info> solve_generic_greater_or_equals(ast_node* node) noexcept {
-            auto const left_solved = solve(node->binary.left);
-            if(!left_solved)
-                return left_solved;
-            auto const right_solved = solve(node->binary.right);
-            if(!right_solved)
-                return right_solved;
+            auto const solved = solve_operands(node);
+            if(!solved)
+                return solved;
+            return type_generic_greater_or_equals(node);
+        }
+
+
+        tl::expected<void, error_info> type_generic_greater_or_equals(ast_node* node) noexcept {
             if(node->binary.left->type != node->binary.right->type)
                 return failed(error::operands_should_have_same_type, node->line_no);
             switch (node->binary.left->type.tag) {
@@ -342,6 +559,9 @@ namespace mandalang {
                     node->tag = ast_node_tag::integer_greater_or_equals;
                     node->type = type{type_tag::boolean};
                     return {};
+                case type_tag::composite:
+                    return type_vector_comparison(node, ast_node_tag::floating_point_vector_greater_or_equals,
+                                                  ast_node_tag::integer_vector_greater_or_equals);
                 default:
                     return failed(error::operands_should_have_numerical_types, node->line_no);
             }
@@ -349,12 +569,14 @@ namespace mandalang {
 
 
         tl::expected<void, error_info> solve_generic_less_than(ast_node* node) noexcept {
-            auto const left_solved = solve(node->binary.left);
-            if(!left_solved)
-                return left_solved;
-            auto const right_solved = solve(node->binary.right);
-            if(!right_solved)
-                return right_solved;
+            auto const solved = solve_operands(node);
+            if(!solved)
+                return solved;
+            return type_generic_less_than(node);
+        }
+
+
+        tl::expected<void, error_info> type_generic_less_than(ast_node* node) noexcept {
             if(node->binary.left->type != node->binary.right->type)
                 return failed(error::operands_should_have_same_type, node->line_no);
             switch (node->binary.left->type.tag) {
@@ -366,6 +588,9 @@ namespace mandalang {
                     node->tag = ast_node_tag::integer_less_than;
                     node->type = type{type_tag::boolean};
                     return {};
+                case type_tag::composite:
+                    return type_vector_comparison(node, ast_node_tag::floating_point_vector_less_than,
+                                                  ast_node_tag::integer_vector_less_than);
                 default:
                     return failed(error::operands_should_have_numerical_types, node->line_no);
             }
@@ -373,12 +598,14 @@ namespace mandalang {
 
 
         tl::expected<void, error_info> solve_generic_less_or_equals(ast_node* node) noexcept {
-            auto const left_solved = solve(node->binary.left);
-            if(!left_solved)
-                return left_solved;
-            auto const right_solved = solve(node->binary.right);
-            if(!right_solved)
-                return right_solved;
+            auto const solved = solve_operands(node);
+            if(!solved)
+                return solved;
+            return type_generic_less_or_equals(node);
+        }
+
+
+        tl::expected<void, error_info> type_generic_less_or_equals(ast_node* node) noexcept {
             if(node->binary.left->type != node->binary.right->type)
                 return failed(error::operands_should_have_same_type, node->line_no);
             switch (node->binary.left->type.tag) {
@@ -390,6 +617,9 @@ namespace mandalang {
                     node->tag = ast_node_tag::integer_less_or_equals;
                     node->type = type{type_tag::boolean};
                     return {};
+                case type_tag::composite:
+                    return type_vector_comparison(node, ast_node_tag::floating_point_vector_less_or_equals,
+                                                  ast_node_tag::integer_vector_less_or_equals);
                 default:
                     return failed(error::operands_should_have_numerical_types, node->line_no);
             }
@@ -397,32 +627,22 @@ namespace mandalang {
 
 
         tl::expected<void, error_info> solve_function(ast_node* node) noexcept {
-            auto solved = solve_type(node->function.result);
+            auto solved = solve_function_header(node);
             if(!solved)
                 return solved;
-            auto i = 0u;
-            type parameters[composite_type::max_function_parameters];
-            for(auto* current_node = node->function.parameters; current_node != nullptr; current_node = current_node->typed_name.next) {
-                solved = solve_type(current_node->typed_name.type);
-                if(!solved)
-                    return solved;
-                auto* parameter_symbol = node->function.scope->find_local(current_node->typed_name.name);
-                if(!parameter_symbol)
-                    return failed(error::invalid_type_resolving, node->line_no, current_node->typed_name.name);
-                parameter_symbol->function_parameter.type = current_node->typed_name.type->type;
-                parameters[i++] = current_node->typed_name.type->type;
-            }
-            auto* function_type = composite_types_.create(node->function.result->type, i, parameters);
-            node->type = type{type_tag::composite, function_type};
-            auto* self = node->function.scope->find_local("self");
-            if(!self)
-                return failed(error::invalid_type_resolving, node->line_no);
-            self->value.type = node->type;
             solved = solve(node->function.body);
             if(!solved)
                 return solved;
+            return type_function(node);
+        }
+
+
+        tl::expected<void, error_info> type_function(ast_node* node) noexcept {
             if(node->function.result->type != node->function.body->type)
                 return failed(error::mismatch_function_type_and_expression, node->line_no);
+            for(auto* capture = node->function.captures; capture != nullptr; capture = capture->binary.right)
+                capture->binary.left->type = capture->binary.left->slot.source->function_parameter.type;
+            last_use::mark(node);
             return {};
         }
 
@@ -431,28 +651,25 @@ namespace mandalang {
             auto solved = solve(node->call.callee);
             if(!solved)
                 return solved;
-            if(node->call.callee->type.tag != type_tag::composite ||
-               node->call.callee->type.composite->tag != composite_type_tag::function)
-                return failed(error::expected_function_to_call, node->line_no);
-            if(node->call.callee->tag == ast_node_tag::resolved_name) {
-                switch(node->call.callee->resolved_name->tag) {
-                    case symbol_tag::fn_parameter:
-                        break;
-                    case symbol_tag::value:
-                        break;
-                    default:
-                        return failed(error::expected_function_to_call, node->line_no);
+            if(node->call.callee->type.tag == type_tag::intrinsic) {
+                for(auto* argument = node->call.arguments; argument != nullptr; argument = argument->binary.right) {
+                    solved = solve(argument->binary.left);
+                    if(!solved)
+                        return solved;
                 }
+                return type_intrinsic_call(node);
             }
-            if(node->call.callee->type.composite->function.arity != node->call.arguments_count)
-                return failed(error::mismatch_parameters_and_arguments_count, node->line_no);
+            solved = type_callee(node);
+            if(!solved)
+                return solved;
             auto parameter_index = 0u;
             for(auto* argument = node->call.arguments; argument != nullptr; argument = argument->binary.right) {
                 solved = solve(argument->binary.left);
                 if(!solved)
                     return solved;
-                if(argument->binary.left->type != node->call.callee->type.composite->function.parameters[parameter_index])
-                    return failed(error::mismatch_parameter_and_argument_types, node->line_no);
+                solved = type_argument(node, argument, parameter_index);
+                if(!solved)
+                    return solved;
                 ++parameter_index;
             }
             node->type = node->call.callee->type.composite->function.result;
@@ -460,6 +677,238 @@ namespace mandalang {
         }
 
 
+        tl::expected<void, error_info> type_function_call(ast_node* node) noexcept {
+            if(node->call.callee->type.tag == type_tag::intrinsic)
+                return type_intrinsic_call(node);
+            auto solved = type_callee(node);
+            if(!solved)
+                return solved;
+            auto parameter_index = 0u;
+            for(auto* argument = node->call.arguments; argument != nullptr; argument = argument->binary.right) {
+                solved = type_argument(node, argument, parameter_index);
+                if(!solved)
+                    return solved;
+                ++parameter_index;
+            }
+            node->type = node->call.callee->type.composite->function.result;
+            return {};
+        }
+
+
+        tl::expected<void, error_info> type_callee(ast_node* node) noexcept {
+            if(node->call.callee->type.tag != type_tag::composite ||
+               node->call.callee->type.composite->tag != composite_type_tag::function)
+                return failed(error::expected_function_to_call, node->line_no);
+            if(node->call.callee->tag == ast_node_tag::resolved_name)
+                return failed(error::expected_function_to_call, node->line_no);
+            if(node->call.callee->type.composite->function.arity != node->call.arguments_count)
+                return failed(error::mismatch_parameters_and_arguments_count, node->line_no);
+            return {};
+        }
+
+
+        // higher-order builtins take the types of their function argument at each call:
+        // map(fn(T) -> U, vector[T]) -> vector[U], filter(fn(T) -> boolean, vector[T]) -> vector[T],
+        // reduce(fn(A, T) -> A, A, vector[T]) -> A, reduce_associative(fn(T, T) -> T, T, vector[T]) -> T
+        // and zip(fn(T1, T2) -> U, vector[T1], vector[T2]) -> vector[U];
+        // range(integer, integer) -> vector[integer] and take(vector[T], integer) -> vector[T] go with them
+        // as stages of lazy pipelines; sum, mean and norm take vector[double] and dot takes two of them;
+        // sort(vector[T]) -> vector[T], argsort(vector[T]) -> vector[integer], partial_sort(vector[T], integer)
+        // -> vector[T], nth_element(vector[T], integer) -> T and lower_bound(vector[T], T) -> integer take
+        // numbers; set(vector[T], integer, T) -> vector[T] and append(vector[T], T) -> vector[T] update
+        // a copy of the vector, slice(vector[T], integer, integer) -> vector[T] and concat(vector[T], vector[T])
+        // -> vector[T] make one; all four take persistent[T] for vector[T] as well, to_persistent(vector[T])
+        // -> persistent[T] and to_vector(persistent[T]) -> vector[T] convert between them; the node is
+        // evaluated as the builtin itself, so the callee is dropped
+        tl::expected<void, error_info> type_intrinsic_call(ast_node* node) noexcept {
+            if(node->call.callee->tag != ast_node_tag::resolved_name)
+                return failed(error::expected_function_to_call, node->line_no);
+            auto const tag = node->call.callee->resolved_name->intrinsic;
+            auto const arity = intrinsic_arity(tag);
+            if(node->call.arguments_count != arity)
+                return failed(error::mismatch_parameters_and_arguments_count, node->line_no);
+            type arguments[3];
+            auto i = 0u;
+            for(auto* argument = node->call.arguments; argument != nullptr; argument = argument->binary.right)
+                arguments[i++] = argument->binary.left->type;
+            if(tag == ast_node_tag::vector_sum || tag == ast_node_tag::vector_mean ||
+               tag == ast_node_tag::vector_dot || tag == ast_node_tag::vector_norm) {
+                for(auto k = 0u; k != arity; ++k)
+                    if(!arguments[k].is_vector() || arguments[k].composite->item.tag != type_tag::floating_point)
+                        return failed(error::mismatch_parameter_and_argument_types, node->line_no);
+                node->type = type{type_tag::floating_point};
+                node->tag = tag;
+                node->call.callee = nullptr;
+                return {};
+            }
+            if(tag == ast_node_tag::vector_sort || tag == ast_node_tag::vector_argsort ||
+               tag == ast_node_tag::vector_partial_sort || tag == ast_node_tag::vector_nth_element ||
+               tag == ast_node_tag::vector_lower_bound)
+                return type_sorting_call(node, tag, arguments);
+            if(tag == ast_node_tag::vector_set || tag == ast_node_tag::vector_append ||
+               tag == ast_node_tag::vector_slice || tag == ast_node_tag::vector_concat ||
+               tag == ast_node_tag::vector_to_persistent || tag == ast_node_tag::persistent_to_vector)
+                return type_update_call(node, tag, arguments);
+            if(tag == ast_node_tag::vector_range || tag == ast_node_tag::vector_take) {
+                auto const source_matched = tag == ast_node_tag::vector_range
+                        ? arguments[0].tag == type_tag::integer
+                        : arguments[0].is_vector();
+                if(!source_matched || arguments[1].tag != type_tag::integer)
+                    return failed(error::mismatch_parameter_and_argument_types, node->line_no);
+                node->type = tag == ast_node_tag::vector_range ? types_.vector(type{type_tag::integer}) : arguments[0];
+                node->tag = tag;
+                node->call.callee = nullptr;
+                return {};
+            }
+            if(arguments[0].tag != type_tag::composite || arguments[0].composite->tag != composite_type_tag::function)
+                return failed(error::expected_function_to_call, node->line_no);
+            auto const& function = arguments[0].composite->function;
+            auto const items_of = [](type const& t, type const& item) noexcept {
+                return t.is_vector() && t.composite->item == item;
+            };
+            auto matched = false;
+            switch(tag) {
+                case ast_node_tag::vector_map:
+                    matched = function.arity == 1 && items_of(arguments[1], function.parameters[0]);
+                    node->type = function.result;
+                    break;
+                case ast_node_tag::vector_filter:
+                    matched = function.arity == 1 && items_of(arguments[1], function.parameters[0]) &&
+                              function.result.tag == type_tag::boolean;
+                    node->type = arguments[1];
+                    break;
+                case ast_node_tag::vector_reduce:
+                    matched = function.arity == 2 && function.result == function.parameters[0] &&
+                              arguments[1] == function.parameters[0] && items_of(arguments[2], function.parameters[1]);
+                    node->type = function.result;
+                    break;
+                case ast_node_tag::vector_reduce_associative:
+                    matched = function.arity == 2 && function.result == function.parameters[0] &&
+                              function.parameters[1] == function.parameters[0] &&
+                              arguments[1] == function.parameters[0] && items_of(arguments[2], function.parameters[1]);
+                    node->type = function.result;
+                    break;
+                case ast_node_tag::vector_zip:
+                    matched = function.arity == 2 && items_of(arguments[1], function.parameters[0]) &&
+                              items_of(arguments[2], function.parameters[1]);
+                    node->type = function.result;
+                    break;
+                default:
+                    return failed(error::invalid_type_resolving, node->line_no);
+            }
+            if(!matched)
+                return failed(error::mismatch_parameter_and_argument_types, node->line_no);
+            if(tag == ast_node_tag::vector_map || tag == ast_node_tag::vector_zip) {
+                if(node->type.tag == type_tag::composite)
+                    return failed(error::vector_items_should_be_numerical, node->line_no);
+                node->type = types_.vector(node->type);
+            }
+            node->tag = tag;
+            node->call.callee = nullptr;
+            return {};
+        }
+
+
+        tl::expected<void, error_info> type_sorting_call(ast_node* node, ast_node_tag tag, type const (&arguments)[3]) noexcept {
+            if(!arguments[0].is_vector())
+                return failed(error::mismatch_parameter_and_argument_types, node->line_no);
+            auto const item = arguments[0].composite->item;
+            if(item.tag != type_tag::floating_point && item.tag != type_tag::integer)
+                return failed(error::operands_should_have_numerical_types, node->line_no);
+            switch(tag) {
+                case ast_node_tag::vector_sort:
+                    node->type = arguments[0];
+                    break;
+                case ast_node_tag::vector_argsort:
+                    node->type = types_.vector(type{type_tag::integer});
+                    break;
+                case ast_node_tag::vector_partial_sort:
+                case ast_node_tag::vector_nth_element:
+                    if(arguments[1].tag != type_tag::integer)
+                        return failed(error::mismatch_parameter_and_argument_types, node->line_no);
+                    node->type = tag == ast_node_tag::vector_partial_sort ? arguments[0] : item;
+                    break;
+                default:
+                    if(arguments[1] != item)
+                        return failed(error::mismatch_parameter_and_argument_types, node->line_no);
+                    node->type = type{type_tag::integer};
+                    break;
+            }
+            node->tag = tag;
+            node->call.callee = nullptr;
+            return {};
+        }
+
+
+        tl::expected<void, error_info> type_update_call(ast_node* node, ast_node_tag tag, type const (&arguments)[3]) noexcept {
+            auto const persistent = arguments[0].is_persistent();
+            if(!arguments[0].is_vector() && !persistent)
+                return failed(error::mismatch_parameter_and_argument_types, node->line_no);
+            auto const& item = arguments[0].composite->item;
+            auto matched = false;
+            switch(tag) {
+                case ast_node_tag::vector_set:
+                    matched = arguments[1].tag == type_tag::integer && arguments[2] == item;
+                    node->type = arguments[0];
+                    break;
+                case ast_node_tag::vector_append:
+                    matched = arguments[1] == item;
+                    node->type = arguments[0];
+                    break;
+                case ast_node_tag::vector_slice:
+                    matched = arguments[1].tag == type_tag::integer && arguments[2].tag == type_tag::integer;
+                    node->type = arguments[0];
+                    break;
+                case ast_node_tag::vector_concat:
+                    matched = arguments[1] == arguments[0];
+                    node->type = arguments[0];
+                    break;
+                case ast_node_tag::vector_to_persistent:
+                    matched = !persistent;
+                    node->type = types_.persistent(item);
+                    break;
+                default:
+                    matched = persistent;
+                    node->type = types_.vector(item);
+                    break;
+            }
+            if(!matched)
+                return failed(error::mismatch_parameter_and_argument_types, node->line_no);
+            node->tag = tag;
+            node->call.callee = nullptr;
+            return {};
+        }
+
+
+        static unsigned intrinsic_arity(ast_node_tag tag) noexcept {
+            switch(tag) {
+                case ast_node_tag::vector_sum:
+                case ast_node_tag::vector_mean:
+                case ast_node_tag::vector_norm:
+                case ast_node_tag::vector_sort:
+                case ast_node_tag::vector_argsort:
+                case ast_node_tag::vector_to_persistent:
+                case ast_node_tag::persistent_to_vector:
+                    return 1;
+                case ast_node_tag::vector_reduce:
+                case ast_node_tag::vector_reduce_associative:
+                case ast_node_tag::vector_zip:
+                case ast_node_tag::vector_set:
+                case ast_node_tag::vector_slice:
+                    return 3;
+                default:
+                    return 2;
+            }
+        }
+
+
+        tl::expected<void, error_info> type_argument(ast_node* node, ast_node* argument, unsigned index) noexcept {
+            if(argument->binary.left->type != node->call.callee->type.composite->function.parameters[index])
+                return failed(error::mismatch_parameter_and_argument_types, node->line_no);
+            return {};
+        }
+
+
         tl::expected<void, error_info> solve_conditional(ast_node* node) noexcept {
             auto solved = solve(node->conditional.condition);
             if(!solved)
@@ -472,6 +921,13 @@ namespace mandalang {
             solved = solve(node->conditional.else_branch);
             if(!solved)
                 return solved;
+            return type_conditional(node);
+        }
+
+
+        tl::expected<void, error_info> type_conditional(ast_node* node) noexcept {
+            if(node->conditional.condition->type.tag != type_tag::boolean)
+                return failed(error::condition_should_be_boolean, node->line_no);
             if(node->conditional.then_branch->type != node->conditional.else_branch->type)
                 return failed(error::conditional_expression_types_mismatch, node->line_no);
             node->type = node->conditional.then_branch->type;
@@ -488,6 +944,9 @@ namespace mandalang {
                     return {};
                 case ast_node_tag::type_function:
                     return solve_function_type(node);
+                case ast_node_tag::type_vector:
+                case ast_node_tag::type_persistent:
+                    return solve_vector_type(node);
                 default:
                     return failed(error::invalid_type_syntax, node->line_no);
             }
@@ -506,8 +965,20 @@ namespace mandalang {
                     return solved;
                 parameter_types[i++] = parameter->type_item.type->type;
             }
-            auto* function_type = composite_types_.create(node->prototype.result->type, i, parameter_types);
-            node->type = type{type_tag::composite, function_type};
+            node->type = types_.function(node->prototype.result->type, i, parameter_types);
+            return {};
+        }
+
+
+        // vectors are packed, so only numbers and booleans are allowed as items
+        tl::expected<void, error_info> solve_vector_type(ast_node* node) noexcept {
+            auto const solved = solve_type(node->unary);
+            if(!solved)
+                return solved;
+            auto const item_type = node->unary->type;
+            if(item_type.tag == type_tag::composite)
+                return failed(error::vector_items_should_be_numerical, node->line_no);
+            node->type = node->tag == ast_node_tag::type_vector ? types_.vector(item_type) : types_.persistent(item_type);
             return {};
         }
     };
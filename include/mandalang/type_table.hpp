@@ -0,0 +1,102 @@
+#pragma once
+
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+
+#include <nonstd/memory_pool.hpp>
+
+#include <mandalang/type.hpp>
+
+
+namespace mandalang {
+
+
+    class type_table {
+
+        struct hash {
+            std::size_t operator () (composite_type const* composite) const noexcept {
+                auto h = std::size_t(composite->tag);
+                switch(composite->tag) {
+                    case composite_type_tag::function:
+                        h = combine(h, composite->function.result);
+                        h = combine(h, std::size_t(composite->function.arity));
+                        for(auto i = 0u; i != composite->function.arity; ++i)
+                            h = combine(h, composite->function.parameters[i]);
+                        return h;
+                    case composite_type_tag::vector:
+                    case composite_type_tag::persistent:
+                        return combine(h, composite->item);
+                    default:
+                        return h;
+                }
+            }
+
+        private:
+
+            static std::size_t combine(std::size_t h, type const& t) noexcept {
+                h = combine(h, std::size_t(t.tag));
+                return combine(h, std::hash<composite_type const*>{}(t.composite));
+            }
+
+            static std::size_t combine(std::size_t h, std::size_t v) noexcept {
+                return h ^ (v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2));
+            }
+        };
+
+        struct equal {
+            bool operator () (composite_type const* left, composite_type const* right) const noexcept {
+                return *left == *right;
+            }
+        };
+
+        mutable std::mutex mutex_;
+        nonstd::memory_pool<composite_type> composite_types_;
+        std::unordered_set<composite_type const*, hash, equal> interned_;
+
+    public:
+
+        type_table() = default;
+        type_table(type_table const&) = delete;
+        type_table& operator = (type_table const&) = delete;
+
+        std::size_t size() const noexcept {
+            auto const lock = std::lock_guard{mutex_};
+            return interned_.size();
+        }
+
+
+        type function(type result, unsigned arity, type parameters[]) {
+            return intern(composite_type{result, arity, parameters});
+        }
+
+
+        type vector(type item) {
+            return intern(composite_type{composite_type_tag::vector, item});
+        }
+
+
+        type persistent(type item) {
+            return intern(composite_type{composite_type_tag::persistent, item});
+        }
+
+    private:
+
+        // component types are canonical already, so comparing a prototype never goes deeper than one level;
+        // types are solved on several loader threads, interning is serialized
+        type intern(composite_type const& prototype) {
+            auto const lock = std::lock_guard{mutex_};
+            auto const found = interned_.find(&prototype);
+            if(found != interned_.end())
+                return type{type_tag::composite, const_cast<composite_type*>(*found)};
+            auto* created = composite_types_.create(prototype);
+            interned_.insert(created);
+            return type{type_tag::composite, created};
+        }
+
+    }; // type_table
+
+
+} // namespace mandalang
@@ -0,0 +1,118 @@
+#pragma once
+
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+
+
+namespace mandalang {
+
+
+    // reference counted header of packed vector items, own items follow the header
+    // aligned to 32 bytes so element-wise loops can use aligned loads; borrowed items
+    // live in memory kept by the owner, such as a mapped module image or an array of the
+    // host, and are read-only;
+    // values of globals are shared between loader threads, so counting is atomic
+    struct vector_buffer {
+        static constexpr std::size_t alignment = 32;
+
+        std::atomic<std::size_t> references;
+        std::size_t size;
+        std::size_t capacity;
+        void* data;
+        std::shared_ptr<void const> owner;
+
+
+        static std::size_t header_size() noexcept {
+            return (sizeof(vector_buffer) + alignment - 1) / alignment * alignment;
+        }
+
+
+        static vector_buffer* allocate(std::size_t capacity, std::size_t item_size) {
+            auto* memory = ::operator new(header_size() + capacity * item_size, std::align_val_t{alignment});
+            return new(memory) vector_buffer{1, 0, capacity, static_cast<char*>(memory) + header_size(), {}};
+        }
+
+
+        static vector_buffer* borrow(void const* items, std::size_t size, std::shared_ptr<void const> owner) {
+            auto* memory = ::operator new(header_size(), std::align_val_t{alignment});
+            return new(memory) vector_buffer{1, size, size, const_cast<void*>(items), std::move(owner)};
+        }
+
+
+        bool borrowed() const noexcept {
+            return owner != nullptr;
+        }
+
+
+        // new buffer of larger capacity with a copy of items
+        vector_buffer* grow(std::size_t new_capacity, std::size_t item_size) const {
+            auto* grown = allocate(new_capacity, item_size);
+            std::memcpy(grown->items<char>(), items<char>(), size * item_size);
+            grown->size = size;
+            return grown;
+        }
+
+
+        template<typename T> T* items() noexcept {
+            return static_cast<T*>(data);
+        }
+
+        template<typename T> T const* items() const noexcept {
+            return static_cast<T const*>(data);
+        }
+
+
+        static void retain(vector_buffer* buffer) noexcept {
+            buffer->references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+
+        static void release(vector_buffer* buffer) noexcept {
+            if(buffer->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            buffer->~vector_buffer();
+            ::operator delete(buffer, std::align_val_t{alignment});
+        }
+
+    }; // vector_buffer
+
+
+    // owning handle of a vector buffer outside of values
+    class vector_reference {
+        vector_buffer* buffer_{nullptr};
+
+    public:
+
+        vector_reference() noexcept = default;
+        explicit vector_reference(vector_buffer* adopted) noexcept: buffer_{adopted} { }
+
+        vector_reference(vector_reference const& other) noexcept: buffer_{other.buffer_} {
+            if(buffer_)
+                vector_buffer::retain(buffer_);
+        }
+
+        vector_reference(vector_reference&& other) noexcept: buffer_{other.buffer_} {
+            other.buffer_ = nullptr;
+        }
+
+        vector_reference& operator = (vector_reference other) noexcept {
+            std::swap(buffer_, other.buffer_);
+            return *this;
+        }
+
+        ~vector_reference() {
+            if(buffer_)
+                vector_buffer::release(buffer_);
+        }
+
+        vector_buffer* get() const noexcept { return buffer_; }
+
+    }; // vector_reference
+
+
+} // namespace mandalang
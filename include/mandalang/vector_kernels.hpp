@@ -0,0 +1,413 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MANDALANG_AVX2_TARGET
+#define MANDALANG_VECTOR_KERNELS_AVX2
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MANDALANG_AVX2_TARGET __attribute__((target("avx2")))
+#define MANDALANG_VECTOR_KERNELS_AVX2
+#define MANDALANG_VECTOR_KERNELS_DISPATCHED
+#endif
+
+
+// element-wise arithmetic, comparisons and sums of packed vector items; avx2 kernels are
+// selected at run time when the processor has them, otherwise scalar loops are used;
+// loads are unaligned, so borrowed items need no particular alignment
+
+
+namespace mandalang::vector_kernels {
+
+
+    enum class arithmetic {
+        add, subtract, multiply, divide
+    }; // arithmetic
+
+
+    enum class comparison {
+        equals_to, not_equals_to, greater_than, greater_or_equals, less_than, less_or_equals
+    }; // comparison
+
+
+    // running sum which keeps the exact rounding error of every addition apart,
+    // so long sums lose no more than a couple of last bits
+    struct compensated_sum {
+        double sum{0.0};
+        double error{0.0};
+
+        void add(double x) noexcept {
+            auto const s = sum + x;
+            auto const b = s - sum;
+            error += (sum - (s - b)) + (x - b);
+            sum = s;
+        }
+
+        void add(compensated_sum const& other) noexcept {
+            add(other.sum);
+            error += other.error;
+        }
+
+        double value() const noexcept {
+            return sum + error;
+        }
+    }; // compensated_sum
+
+
+    // sums run in eight interleaved lanes, item i goes to lane i % 8 and lanes are
+    // combined as a tree; scalar and avx2 kernels do the same additions in the same order
+    inline constexpr std::size_t sum_lanes = 8;
+
+
+    inline compensated_sum combine(compensated_sum (&lanes)[sum_lanes]) noexcept {
+        for(auto width = sum_lanes / 2; width != 0; width /= 2)
+            for(auto k = std::size_t(0); k != width; ++k)
+                lanes[k].add(lanes[k + width]);
+        return lanes[0];
+    }
+
+
+    namespace scalar {
+
+        template<typename T, typename F> void apply(T const* a, T const* b, T* r, std::size_t n, F f) noexcept {
+            for(auto i = std::size_t(0); i != n; ++i)
+                r[i] = f(a[i], b[i]);
+        }
+
+
+        template<typename T> void apply(arithmetic op, T const* a, T const* b, T* r, std::size_t n) noexcept {
+            switch(op) {
+                case arithmetic::add:
+                    return apply(a, b, r, n, [](T x, T y) { return x + y; });
+                case arithmetic::subtract:
+                    return apply(a, b, r, n, [](T x, T y) { return x - y; });
+                case arithmetic::multiply:
+                    return apply(a, b, r, n, [](T x, T y) { return x * y; });
+                case arithmetic::divide:
+                    return apply(a, b, r, n, [](T x, T y) { return x / y; });
+            }
+        }
+
+
+        template<typename T, typename F> void compare(T const* a, T const* b, bool* r, std::size_t n, F f) noexcept {
+            for(auto i = std::size_t(0); i != n; ++i)
+                r[i] = f(a[i], b[i]);
+        }
+
+
+        template<typename T> void compare(comparison op, T const* a, T const* b, bool* r, std::size_t n) noexcept {
+            switch(op) {
+                case comparison::equals_to:
+                    return compare(a, b, r, n, [](T x, T y) { return x == y; });
+                case comparison::not_equals_to:
+                    return compare(a, b, r, n, [](T x, T y) { return x != y; });
+                case comparison::greater_than:
+                    return compare(a, b, r, n, [](T x, T y) { return x > y; });
+                case comparison::greater_or_equals:
+                    return compare(a, b, r, n, [](T x, T y) { return x >= y; });
+                case comparison::less_than:
+                    return compare(a, b, r, n, [](T x, T y) { return x < y; });
+                case comparison::less_or_equals:
+                    return compare(a, b, r, n, [](T x, T y) { return x <= y; });
+            }
+        }
+
+
+
+        // lanes are given items from done onwards
+        template<typename F> void sum(compensated_sum (&lanes)[sum_lanes], std::size_t done, std::size_t n,
+                                      F item) noexcept {
+            auto i = done;
+            for(; i + sum_lanes <= n; i += sum_lanes)
+                for(auto k = std::size_t(0); k != sum_lanes; ++k)
+                    lanes[k].add(item(i + k));
+            for(auto k = std::size_t(0); i + k < n; ++k)
+                lanes[k].add(item(i + k));
+        }
+
+    } // namespace scalar
+
+
+#if defined(MANDALANG_VECTOR_KERNELS_AVX2)
+
+    // kernels process whole chunks of four items and return how many are done
+    namespace avx2 {
+
+        struct add {
+            MANDALANG_AVX2_TARGET __m256d operator()(__m256d a, __m256d b) const noexcept { return _mm256_add_pd(a, b); }
+            MANDALANG_AVX2_TARGET __m256i operator()(__m256i a, __m256i b) const noexcept { return _mm256_add_epi64(a, b); }
+        };
+
+        struct subtract {
+            MANDALANG_AVX2_TARGET __m256d operator()(__m256d a, __m256d b) const noexcept { return _mm256_sub_pd(a, b); }
+            MANDALANG_AVX2_TARGET __m256i operator()(__m256i a, __m256i b) const noexcept { return _mm256_sub_epi64(a, b); }
+        };
+
+        // low halves of 64 bit products are built from 32 bit multiplications
+        struct multiply {
+            MANDALANG_AVX2_TARGET __m256d operator()(__m256d a, __m256d b) const noexcept { return _mm256_mul_pd(a, b); }
+            MANDALANG_AVX2_TARGET __m256i operator()(__m256i a, __m256i b) const noexcept {
+                auto const cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                                    _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+                return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+            }
+        };
+
+        // there is no integer division, integers are divided by scalar loop
+        struct divide {
+            MANDALANG_AVX2_TARGET __m256d operator()(__m256d a, __m256d b) const noexcept { return _mm256_div_pd(a, b); }
+        };
+
+        // comparisons set all bits of lanes where they hold, nan compares as unequal
+        struct equals_to {
+            MANDALANG_AVX2_TARGET __m256d operator()(__m256d a, __m256d b) const noexcept { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+            MANDALANG_AVX2_TARGET __m256i operator()(__m256i a, __m256i b) const noexcept { return _mm256_cmpeq_epi64(a, b); }
+        };
+
+        struct not_equals_to {
+            MANDALANG_AVX2_TARGET __m256d operator()(__m256d a, __m256d b) const noexcept { return _mm256_cmp_pd(a, b, _CMP_NEQ_UQ); }
+            MANDALANG_AVX2_TARGET __m256i operator()(__m256i a, __m256i b) const noexcept {
+                return _mm256_xor_si256(_mm256_cmpeq_epi64(a, b), _mm256_set1_epi64x(-1));
+            }
+        };
+
+        struct greater_than {
+            MANDALANG_AVX2_TARGET __m256d operator()(__m256d a, __m256d b) const noexcept { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+            MANDALANG_AVX2_TARGET __m256i operator()(__m256i a, __m256i b) const noexcept { return _mm256_cmpgt_epi64(a, b); }
+        };
+
+        struct greater_or_equals {
+            MANDALANG_AVX2_TARGET __m256d operator()(__m256d a, __m256d b) const noexcept { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+            MANDALANG_AVX2_TARGET __m256i operator()(__m256i a, __m256i b) const noexcept {
+                return _mm256_xor_si256(_mm256_cmpgt_epi64(b, a), _mm256_set1_epi64x(-1));
+            }
+        };
+
+        struct less_than {
+            MANDALANG_AVX2_TARGET __m256d operator()(__m256d a, __m256d b) const noexcept { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+            MANDALANG_AVX2_TARGET __m256i operator()(__m256i a, __m256i b) const noexcept { return _mm256_cmpgt_epi64(b, a); }
+        };
+
+        struct less_or_equals {
+            MANDALANG_AVX2_TARGET __m256d operator()(__m256d a, __m256d b) const noexcept { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+            MANDALANG_AVX2_TARGET __m256i operator()(__m256i a, __m256i b) const noexcept {
+                return _mm256_xor_si256(_mm256_cmpgt_epi64(a, b), _mm256_set1_epi64x(-1));
+            }
+        };
+
+
+        MANDALANG_AVX2_TARGET inline __m256d load(double const* p) noexcept {
+            return _mm256_loadu_pd(p);
+        }
+
+        MANDALANG_AVX2_TARGET inline __m256i load(std::int64_t const* p) noexcept {
+            return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p));
+        }
+
+        MANDALANG_AVX2_TARGET inline void store(double* p, __m256d v) noexcept {
+            _mm256_storeu_pd(p, v);
+        }
+
+        MANDALANG_AVX2_TARGET inline void store(std::int64_t* p, __m256i v) noexcept {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+        }
+
+        MANDALANG_AVX2_TARGET inline int mask(__m256d v) noexcept {
+            return _mm256_movemask_pd(v);
+        }
+
+        MANDALANG_AVX2_TARGET inline int mask(__m256i v) noexcept {
+            return _mm256_movemask_pd(_mm256_castsi256_pd(v));
+        }
+
+
+        template<typename T, typename F>
+        MANDALANG_AVX2_TARGET std::size_t apply(T const* a, T const* b, T* r, std::size_t n, F f) noexcept {
+            auto i = std::size_t(0);
+            for(; i + 4 <= n; i += 4)
+                store(r + i, f(load(a + i), load(b + i)));
+            return i;
+        }
+
+
+        template<typename T, typename F>
+        MANDALANG_AVX2_TARGET std::size_t compare(T const* a, T const* b, bool* r, std::size_t n, F f) noexcept {
+            auto i = std::size_t(0);
+            for(; i + 4 <= n; i += 4) {
+                auto const bits = mask(f(load(a + i), load(b + i)));
+                r[i] = (bits & 1) != 0;
+                r[i + 1] = (bits & 2) != 0;
+                r[i + 2] = (bits & 4) != 0;
+                r[i + 3] = (bits & 8) != 0;
+            }
+            return i;
+        }
+
+
+        inline std::size_t apply(arithmetic op, double const* a, double const* b, double* r, std::size_t n) noexcept {
+            switch(op) {
+                case arithmetic::add:
+                    return apply(a, b, r, n, add{});
+                case arithmetic::subtract:
+                    return apply(a, b, r, n, subtract{});
+                case arithmetic::multiply:
+                    return apply(a, b, r, n, multiply{});
+                case arithmetic::divide:
+                    return apply(a, b, r, n, divide{});
+            }
+            return 0;
+        }
+
+
+        inline std::size_t apply(arithmetic op, std::int64_t const* a, std::int64_t const* b, std::int64_t* r,
+                                 std::size_t n) noexcept {
+            switch(op) {
+                case arithmetic::add:
+                    return apply(a, b, r, n, add{});
+                case arithmetic::subtract:
+                    return apply(a, b, r, n, subtract{});
+                case arithmetic::multiply:
+                    return apply(a, b, r, n, multiply{});
+                default:
+                    return 0;
+            }
+        }
+
+
+        MANDALANG_AVX2_TARGET inline void add(__m256d& sum, __m256d& error, __m256d x) noexcept {
+            auto const s = _mm256_add_pd(sum, x);
+            auto const b = _mm256_sub_pd(s, sum);
+            error = _mm256_add_pd(error, _mm256_add_pd(_mm256_sub_pd(sum, _mm256_sub_pd(s, b)), _mm256_sub_pd(x, b)));
+            sum = s;
+        }
+
+
+        struct items {
+            double const* a;
+            MANDALANG_AVX2_TARGET __m256d operator()(std::size_t i) const noexcept { return load(a + i); }
+        };
+
+        struct products {
+            double const* a;
+            double const* b;
+            MANDALANG_AVX2_TARGET __m256d operator()(std::size_t i) const noexcept {
+                return _mm256_mul_pd(load(a + i), load(b + i));
+            }
+        };
+
+
+        // fills lanes with whole rows of eight items and returns how many are done
+        template<typename F>
+        MANDALANG_AVX2_TARGET std::size_t sum(compensated_sum (&lanes)[sum_lanes], std::size_t n, F item) noexcept {
+            auto low = _mm256_setzero_pd();
+            auto low_error = _mm256_setzero_pd();
+            auto high = _mm256_setzero_pd();
+            auto high_error = _mm256_setzero_pd();
+            auto i = std::size_t(0);
+            for(; i + sum_lanes <= n; i += sum_lanes) {
+                add(low, low_error, item(i));
+                add(high, high_error, item(i + 4));
+            }
+            alignas(32) double sums[sum_lanes];
+            alignas(32) double errors[sum_lanes];
+            _mm256_store_pd(sums, low);
+            _mm256_store_pd(sums + 4, high);
+            _mm256_store_pd(errors, low_error);
+            _mm256_store_pd(errors + 4, high_error);
+            for(auto k = std::size_t(0); k != sum_lanes; ++k)
+                lanes[k] = compensated_sum{sums[k], errors[k]};
+            return i;
+        }
+
+
+        template<typename T> std::size_t compare(comparison op, T const* a, T const* b, bool* r, std::size_t n) noexcept {
+            switch(op) {
+                case comparison::equals_to:
+                    return compare(a, b, r, n, equals_to{});
+                case comparison::not_equals_to:
+                    return compare(a, b, r, n, not_equals_to{});
+                case comparison::greater_than:
+                    return compare(a, b, r, n, greater_than{});
+                case comparison::greater_or_equals:
+                    return compare(a, b, r, n, greater_or_equals{});
+                case comparison::less_than:
+                    return compare(a, b, r, n, less_than{});
+                case comparison::less_or_equals:
+                    return compare(a, b, r, n, less_or_equals{});
+            }
+            return 0;
+        }
+
+    } // namespace avx2
+
+#endif
+
+
+    inline bool avx2_supported() noexcept {
+#if defined(MANDALANG_VECTOR_KERNELS_DISPATCHED)
+        static bool const supported = [] {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") != 0;
+        }();
+        return supported;
+#elif defined(MANDALANG_VECTOR_KERNELS_AVX2)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+
+    // items are double or 64 bit integers for avx2 kernels, other integers take scalar loops
+    template<typename T> void apply(arithmetic op, T const* a, T const* b, T* r, std::size_t n) noexcept {
+        auto done = std::size_t(0);
+#if defined(MANDALANG_VECTOR_KERNELS_AVX2)
+        if constexpr(std::is_same_v<T, double> || std::is_same_v<T, std::int64_t>)
+            if(avx2_supported())
+                done = avx2::apply(op, a, b, r, n);
+#endif
+        scalar::apply(op, a + done, b + done, r + done, n - done);
+    }
+
+
+    template<typename T> void compare(comparison op, T const* a, T const* b, bool* r, std::size_t n) noexcept {
+        auto done = std::size_t(0);
+#if defined(MANDALANG_VECTOR_KERNELS_AVX2)
+        if constexpr(std::is_same_v<T, double> || std::is_same_v<T, std::int64_t>)
+            if(avx2_supported())
+                done = avx2::compare(op, a, b, r, n);
+#endif
+        scalar::compare(op, a + done, b + done, r + done, n - done);
+    }
+
+
+    inline compensated_sum sum(double const* a, std::size_t n) noexcept {
+        compensated_sum lanes[sum_lanes] = {};
+        auto done = std::size_t(0);
+#if defined(MANDALANG_VECTOR_KERNELS_AVX2)
+        if(avx2_supported())
+            done = avx2::sum(lanes, n, avx2::items{a});
+#endif
+        scalar::sum(lanes, done, n, [a](std::size_t i) { return a[i]; });
+        return combine(lanes);
+    }
+
+
+    inline compensated_sum dot(double const* a, double const* b, std::size_t n) noexcept {
+        compensated_sum lanes[sum_lanes] = {};
+        auto done = std::size_t(0);
+#if defined(MANDALANG_VECTOR_KERNELS_AVX2)
+        if(avx2_supported())
+            done = avx2::sum(lanes, n, avx2::products{a, b});
+#endif
+        scalar::sum(lanes, done, n, [a, b](std::size_t i) { return a[i] * b[i]; });
+        return combine(lanes);
+    }
+
+
+} // namespace mandalang::vector_kernels
@@ -0,0 +1,127 @@
+#pragma once
+
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include <mandalang/thread_pool.hpp>
+
+
+// sorting of packed vector items: integers are sorted by radix, other items by chunks
+// sorted on the shared thread pool and merged pairwise
+
+
+namespace mandalang::vector_sort {
+
+
+    // inputs smaller than this are sorted by a single thread
+    inline constexpr std::size_t parallel_sort_size = 16384;
+
+
+    // doubles are ordered totally: -0 goes before +0 and nan after all numbers
+    template<typename T> struct less {
+        bool operator()(T a, T b) const noexcept {
+            if constexpr(std::is_floating_point_v<T>)
+                return a < b || (a == b && std::signbit(a) && !std::signbit(b)) || (!std::isnan(a) && std::isnan(b));
+            else
+                return a < b;
+        }
+    }; // less
+
+
+    // runs task(i) for each i below count, on the shared pool when there is a choice
+    template<typename F> void run(std::size_t count, F const& task) {
+        auto& pool = thread_pool::shared();
+        if(count < 2 || pool.size() < 2) {
+            for(auto i = std::size_t(0); i != count; ++i)
+                task(i);
+            return;
+        }
+        pool.fork_join(count, task);
+    }
+
+
+    // sorts a chunk for every thread and merges chunks pairwise level by level,
+    // scratch has room for n items
+    template<typename T, typename Less> void merge_sort(T* items, T* scratch, std::size_t n, Less less) {
+        auto const threads = thread_pool::shared().size();
+        auto const chunk = n < parallel_sort_size ? n : std::max(parallel_sort_size, (n + threads - 1) / threads);
+        if(chunk == n) {
+            std::sort(items, items + n, less);
+            return;
+        }
+        run((n + chunk - 1) / chunk, [&](std::size_t i) {
+            std::sort(items + i * chunk, items + std::min(n, (i + 1) * chunk), less);
+        });
+        auto* from = items;
+        auto* to = scratch;
+        for(auto width = chunk; width < n; width *= 2) {
+            run((n + 2 * width - 1) / (2 * width), [&](std::size_t i) {
+                auto const begin = i * 2 * width;
+                auto const middle = std::min(n, begin + width);
+                auto const end = std::min(n, begin + 2 * width);
+                std::merge(from + begin, from + middle, from + middle, from + end, to + begin, less);
+            });
+            std::swap(from, to);
+        }
+        if(from != items)
+            std::copy(from, from + n, items);
+    }
+
+
+    // least significant digit first by bytes of distances from the least item,
+    // so only as many passes are made as the span of items needs
+    template<typename T> void radix_sort(T* items, T* scratch, std::size_t n) noexcept {
+        using digits = std::make_unsigned_t<T>;
+        auto const [least, greatest] = std::minmax_element(items, items + n);
+        auto const base = digits(*least);
+        auto const span = digits(digits(*greatest) - base);
+        auto* from = items;
+        auto* to = scratch;
+        for(auto shift = 0u; shift != sizeof(T) * CHAR_BIT && (span >> shift) != 0; shift += 8) {
+            auto const digit = [shift, base](T x) noexcept {
+                return std::size_t((digits(digits(x) - base) >> shift) & 0xff);
+            };
+            std::size_t offsets[256] = {};
+            for(auto i = std::size_t(0); i != n; ++i)
+                ++offsets[digit(from[i])];
+            auto offset = std::size_t(0);
+            for(auto& each_offset: offsets)
+                offset += std::exchange(each_offset, offset);
+            for(auto i = std::size_t(0); i != n; ++i)
+                to[offsets[digit(from[i])]++] = from[i];
+            std::swap(from, to);
+        }
+        if(from != items)
+            std::memcpy(items, from, n * sizeof(T));
+    }
+
+
+    template<typename T> void sort(T* items, T* scratch, std::size_t n) {
+        if(n < 2)
+            return;
+        if constexpr(std::is_integral_v<T>) {
+            if(n >= 256)
+                return radix_sort(items, scratch, n);
+        }
+        merge_sort(items, scratch, n, less<T>{});
+    }
+
+
+    // positions of items in sorted order, equal items keep their order
+    template<typename T, typename I> void argsort(T const* items, I* indices, I* scratch, std::size_t n) {
+        for(auto i = std::size_t(0); i != n; ++i)
+            indices[i] = I(i);
+        merge_sort(indices, scratch, n, [items](I a, I b) noexcept {
+            auto const order = less<T>{};
+            return order(items[a], items[b]) || (!order(items[b], items[a]) && a < b);
+        });
+    }
+
+
+} // namespace mandalang::vector_sort
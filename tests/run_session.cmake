@@ -0,0 +1,6 @@
+# feeds a session to the interactive interpreter and expects its output to match
+execute_process(COMMAND ${PROGRAM} INPUT_FILE ${SESSION} OUTPUT_VARIABLE output ERROR_VARIABLE errors
+                RESULT_VARIABLE result TIMEOUT 60)
+if(NOT result EQUAL 0 OR NOT errors STREQUAL "" OR NOT output MATCHES "${EXPECTED}")
+    message(FATAL_ERROR "session ${SESSION} printed:\n${output}${errors}")
+endif()